@@ -0,0 +1,164 @@
+/// Per-call latency of the Database hot queries with the indexes of Database::createIndexes() (after) and without them (before).
+/// Each query that Database prepares once per connection also runs "not prepared": the same query through a plain get_all/count/update_all,
+/// which compiles its statement again on every call, to measure what the prepared statements save.
+/// Usage: DatabaseBenchmark [watches] [calls]
+/// Fills a new database with `watches` random watches (1M by default) of watches/50 users and watches/5 repositories,
+/// then calls each query `calls` times (1000 by default) with random arguments through the real Database code.
+/// The database lives in the benchmark's own res directory (see CMakeLists.txt), the bot's res/Database.db is never touched.
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "db/Database.hpp"
+
+namespace {
+  using Clock = std::chrono::steady_clock;
+
+  std::string repoFullName(models::RepositoryId repoId) {
+    return "owner" + std::to_string(repoId % 1000) + "/repo" + std::to_string(repoId);
+  }
+
+  /// Creates users, repositories and watches in a single transaction on the writer thread
+  void populate(std::size_t usersCount, std::size_t reposCount, std::size_t watchesCount, std::mt19937_64 &rng) {
+    std::uniform_int_distribution<models::UserId> randomUser(1, static_cast<models::UserId>(usersCount));
+    std::uniform_int_distribution<models::RepositoryId> randomRepo(1, static_cast<models::RepositoryId>(reposCount));
+    Database::write([&] {
+      auto &storage = Database::getStorage();
+      storage.transaction([&] {
+        for (std::size_t id = 1; id <= usersCount; ++id) {
+          models::User user{};
+          user.id = static_cast<models::UserId>(id);
+          user.chatId = user.id;
+          user.username = "user" + std::to_string(id);
+          storage.replace(user);
+        }
+        for (std::size_t id = 1; id <= reposCount; ++id) {
+          models::Repository repo{};
+          repo.id = static_cast<models::RepositoryId>(id);
+          repo.full_name = repoFullName(repo.id);
+          repo.language = "C++";
+          storage.replace(repo);
+        }
+        for (std::size_t i = 0; i < watchesCount; ++i) {
+          storage.replace(models::Watch{.user_id = randomUser(rng), .repo_id = randomRepo(rng), .createdAt = std::time(nullptr)}); // duplicates are merged
+        }
+        return true; // commit
+      });
+    });
+  }
+
+  /// Calls query `calls` times and prints mean, median and 99th percentile latency
+  void run(const std::string &name, std::size_t calls, const std::function<void()> &query) {
+    std::vector<double> latencies{};
+    latencies.reserve(calls);
+    for (std::size_t i = 0; i < calls; ++i) {
+      const Clock::time_point start = Clock::now();
+      query();
+      latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    std::ranges::sort(latencies);
+    double total = 0;
+    for (const double latency: latencies) total += latency;
+    std::cout << "  " << std::left << std::setw(42) << name << std::right << std::fixed << std::setprecision(1)
+              << " mean " << std::setw(9) << total / calls << "us"
+              << "  p50 " << std::setw(9) << latencies[latencies.size() / 2] << "us"
+              << "  p99 " << std::setw(9) << latencies[latencies.size() * 99 / 100] << "us" << std::endl;
+  }
+
+  using WatchPair = std::pair<models::UserId, models::RepositoryId>;
+
+  void runAll(std::size_t usersCount, std::size_t reposCount, const std::vector<WatchPair> &watches, std::size_t calls, std::mt19937_64 &rng) {
+    std::uniform_int_distribution<models::UserId> randomUser(1, static_cast<models::UserId>(usersCount));
+    std::uniform_int_distribution<models::RepositoryId> randomRepo(1, static_cast<models::RepositoryId>(reposCount));
+    std::uniform_int_distribution<std::size_t> randomWatch(0, watches.size() - 1);
+    const auto randomUpperFullName = [&] {
+      std::string fullName = repoFullName(randomRepo(rng));
+      std::ranges::transform(fullName, fullName.begin(), [](unsigned char c) { return static_cast<char>(std::toupper(c)); }); // matched case insensitively
+      return fullName;
+    };
+    run("userReposCount", calls, [&] { (void) Database::userReposCount(randomUser(rng)); });
+    run("userReposCount (not prepared)", calls, [&] {
+      (void) Database::getReadStorage().count<models::Watch>(where(c(&models::Watch::user_id) == randomUser(rng)));
+    });
+    run("repoExists", calls, [&] { (void) Database::repoExists(randomRepo(rng)); });
+    run("repoExists (not prepared)", calls, [&] {
+      (void) Database::getReadStorage().count<models::Repository>(where(c(&models::Repository::id) == randomRepo(rng)));
+    });
+    run("userWatchesRepoByFullName", calls, [&] { (void) Database::userWatchesRepoByFullName(randomUser(rng), repoFullName(randomRepo(rng))); });
+    run("userWatchesRepoByFullName (not prepared)", calls, [&] {
+      const models::UserId userId = randomUser(rng);
+      (void) Database::getReadStorage().count<models::Repository>(
+        where(lower(&models::Repository::full_name) == tgbotxx::StringUtils::toLowerCopy(repoFullName(randomRepo(rng))) and
+              in(&models::Repository::id, select(&models::Watch::repo_id, where(c(&models::Watch::user_id) == userId)))));
+    });
+    run("findRepoByFullName", calls, [&] { (void) Database::findRepoByFullName(randomUpperFullName()); });
+    run("findRepoByFullName (not prepared)", calls, [&] {
+      (void) Database::getReadStorage().get_all<models::Repository>(
+        where(lower(&models::Repository::full_name) == tgbotxx::StringUtils::toLowerCopy(randomUpperFullName())),
+        limit(1));
+    });
+    run("getUserRepos", calls, [&] { (void) Database::getUserRepos(randomUser(rng)); });
+    run("updateRepoSchedule", calls, [&] { Database::updateRepoSchedule(randomRepo(rng), std::time(nullptr) + 3600, 3600, std::time(nullptr)); });
+    run("updateRepoSchedule (not prepared)", calls, [&] {
+      const models::RepositoryId repoId = randomRepo(rng);
+      Database::write([repoId] {
+        const std::time_t now = std::time(nullptr);
+        Database::getStorage().update_all(
+          set(c(&models::Repository::next_poll_at) = now + 3600,
+              c(&models::Repository::poll_interval) = std::int64_t{3600},
+              c(&models::Repository::last_changed_at) = now),
+          where(c(&models::Repository::id) == repoId));
+      });
+    });
+    run("removeUserRepo+addUserRepo", calls, [&] {
+      // Unwatch then watch again, removal counts the repository's remaining watchers
+      const auto [userId, repoId] = watches[randomWatch(rng)];
+      models::Repository repo{};
+      repo.id = repoId;
+      repo.full_name = repoFullName(repoId);
+      Database::removeUserRepo(userId, repoId);
+      Database::addUserRepo(userId, repo);
+    });
+  }
+}
+
+int main(int argc, const char *argv[]) {
+  const std::size_t watchesCount = argc >= 2 ? std::max(100, std::atoi(argv[1])) : 1'000'000;
+  const std::size_t calls = argc >= 3 ? std::max(1, std::atoi(argv[2])) : 1000;
+  const std::size_t usersCount = watchesCount / 50, reposCount = watchesCount / 5;
+
+  const fs::path resDir = RES_DIR;
+  fs::create_directories(resDir);
+  for (const char *file: {"Database.db", "Database.db-wal", "Database.db-shm"})
+    fs::remove(resDir / file);
+
+  std::mt19937_64 rng{42};
+  const Clock::time_point start = Clock::now();
+  populate(usersCount, reposCount, watchesCount, rng);
+  std::vector<WatchPair> watches{};
+  watches.reserve(watchesCount);
+  const auto reposWatchers = Database::getReposWatchers();
+  for (const auto &[repoId, watchers]: reposWatchers)
+    for (const models::UserId userId: watchers)
+      watches.emplace_back(userId, repoId);
+  std::cout << watches.size() << " watches of " << reposWatchers.size() << " repositories by " << usersCount << " users ("
+            << std::chrono::duration_cast<std::chrono::seconds>(Clock::now() - start).count() << "s to populate " << resDir / "Database.db" << ")" << std::endl;
+
+  std::cout << "with indexes:" << std::endl;
+  runAll(usersCount, reposCount, watches, calls, rng);
+
+  Database::write([] {
+    Database::getStorage().drop_index("idx_watches_repo_id");
+    Database::getStorage().drop_index("idx_repositories_lower_full_name");
+  });
+  std::cout << "without indexes:" << std::endl;
+  runAll(usersCount, reposCount, watches, calls, rng);
+  return EXIT_SUCCESS;
+}
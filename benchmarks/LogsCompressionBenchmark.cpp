@@ -0,0 +1,67 @@
+/// On-disk size of a logs database with long messages stored as TEXT (before) and compressed with models::Log::setLongMessage() (after).
+/// Usage: LogsCompressionBenchmark <corpus.jsonl> [output directory]
+/// The corpus holds one {"severity", "shortMessage", "longMessage"} object per line (see log_corpus.py).
+/// The compressed database uses res/Logs.zdict as dictionary if it exists, like the bot does.
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "db/models/Log.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+  /// Saves logs into a new database in batches of 1024 per transaction like LogWriter, returns the database file size
+  std::uintmax_t save(const fs::path &file, const std::vector<models::Log> &logs) {
+    fs::remove(file);
+    auto storage = sqlite_orm::make_storage(file.string(), models::Log::table());
+    storage.sync_schema();
+    for (std::size_t first = 0; first < logs.size(); first += 1024) {
+      storage.transaction([&] {
+        for (std::size_t i = first; i < std::min(logs.size(), first + 1024); ++i)
+          storage.insert(logs[i]);
+        return true;
+      });
+    }
+    return fs::file_size(file);
+  }
+}
+
+int main(int argc, const char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <corpus.jsonl> [output directory]" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const fs::path outputDir = argc >= 3 ? argv[2] : fs::temp_directory_path();
+
+  std::vector<models::Log> plain{}, compressed{};
+  std::uintmax_t longMessagesSize{}, compressedSize{};
+  std::ifstream ifs{argv[1]};
+  for (std::string line; std::getline(ifs, line);) {
+    const nlohmann::json record = nlohmann::json::parse(line);
+    models::Log log{};
+    log.severity = record["severity"];
+    log.shortMessage = record["shortMessage"];
+    log.timestamp = std::time(nullptr);
+    log.filename = __FILE__;
+    log.functionName = __PRETTY_FUNCTION__;
+    const std::string longMessage = record["longMessage"];
+    longMessagesSize += longMessage.size();
+
+    log.longMessage = longMessage;
+    plain.push_back(log);
+    log.setLongMessage(longMessage);
+    compressedSize += log.longMessageZstd ? log.longMessageZstd->size() : log.longMessage.size();
+    compressed.push_back(std::move(log));
+  }
+
+  const std::uintmax_t before = save(outputDir / "Logs-text.db", plain);
+  const std::uintmax_t after = save(outputDir / "Logs-zstd.db", compressed);
+  std::cout << plain.size() << " logs, long messages " << longMessagesSize << " -> " << compressedSize << " bytes"
+            << (models::Log::codec().dictionaryId() ? " (with res/Logs.zdict)" : "") << '\n'
+            << "Logs.db " << before << " -> " << after << " bytes (" << 100 - after * 100 / std::max<std::uintmax_t>(1, before) << "% smaller)" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,69 @@
+/// Per-request latency of a new cpr::Session per request (every request pays for TCP + TLS setup)
+/// against sessions borrowed from a SessionPool (connections kept alive between requests).
+/// Usage: SessionPoolBenchmark <https url> [requests]
+/// Point it at a local TLS stand-in server (see tls_stand_in_server.py) so the network doesn't blur the numbers.
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "api/SessionPool.hpp"
+
+namespace {
+  using Clock = std::chrono::steady_clock;
+
+  void prepare(cpr::Session &session, const std::string &url) {
+    session.SetUrl(url);
+    session.SetVerifySsl(cpr::VerifySsl{false}); // the stand-in server uses a self-signed certificate
+    session.SetConnectTimeout(cpr::ConnectTimeout{std::chrono::seconds(10)});
+    session.SetTimeout(cpr::Timeout{std::chrono::seconds(30)});
+  }
+
+  /// Sends requests through send and prints mean, median and 99th percentile latency
+  void run(const std::string &name, std::size_t requests, const std::function<cpr::Response()> &send) {
+    std::vector<double> latencies{};
+    latencies.reserve(requests);
+    for (std::size_t i = 0; i < requests; ++i) {
+      const Clock::time_point start = Clock::now();
+      const cpr::Response res = send();
+      latencies.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+      if (res.error or res.status_code != 200) {
+        std::cerr << name << ": request failed (" << res.status_code << ") " << res.error.message << std::endl;
+        std::exit(EXIT_FAILURE);
+      }
+    }
+    std::ranges::sort(latencies);
+    double total = 0;
+    for (const double latency: latencies) total += latency;
+    std::cout << std::left << std::setw(14) << name << std::right << std::fixed << std::setprecision(3)
+              << " mean " << total / requests << "ms"
+              << "  p50 " << latencies[latencies.size() / 2] << "ms"
+              << "  p99 " << latencies[latencies.size() * 99 / 100] << "ms" << std::endl;
+  }
+}
+
+int main(int argc, const char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <https url> [requests]" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const std::string url = argv[1];
+  const std::size_t requests = argc >= 3 ? std::max(1, std::atoi(argv[2])) : 500;
+
+  run("new session", requests, [&url] {
+    cpr::Session session{};
+    prepare(session, url);
+    return session.Get();
+  });
+
+  SessionPool pool{1};
+  run("pooled", requests, [&url, &pool] {
+    SessionPool::Lease session = pool.acquire();
+    prepare(*session, url);
+    return session->Get();
+  });
+  return EXIT_SUCCESS;
+}
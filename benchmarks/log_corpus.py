@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+# Replayed logs corpus for LogsCompressionBenchmark, modelled on the bot's LOG*2 call sites: Telegram updates json dumps
+# (onCommand, onNonCommandMessage, callback queries), admin notifications, GitHub error pages and GraphQL errors.
+# Usage: log_corpus.py <records> [seed] > corpus.jsonl  (one {"severity", "shortMessage", "longMessage"} object per line)
+import json
+import random
+import sys
+
+random.seed(int(sys.argv[2]) if len(sys.argv) > 2 else 1)
+N = int(sys.argv[1])
+first = ["Alex","Sam","Yuki","Bader","Maria","Chen","Omar","Lena","Ivan","Priya","Lucas","Sofia","Ahmed","Emma","Noah"]
+last = ["", "Smith","Tanaka","Ouaich","Garcia","Wang","Haddad","Müller","Petrov","Patel","Silva","Rossi"]
+langs = ["en","fr","de","es","ru","ar","ja","zh-hans","pt-br","it"]
+owners = ["torvalds","microsoft","facebook","google","baderouaich","rust-lang","python","nodejs","vercel","apple","openai","tensorflow","golang","kubernetes"]
+names = ["linux","vscode","react","tgbotxx","GitWatcherBot","rust","cpython","node","next.js","swift","whisper","tensorflow","go","kubernetes","sqlite_orm","cpr","zstd"]
+cmds = ["/start","/my_repos","/watch_repo","/unwatch_repo"]
+def user(uid):
+    u = {"id": uid, "is_bot": False, "first_name": random.choice(first)}
+    l = random.choice(last)
+    if l: u["last_name"] = l
+    if random.random() < .7: u["username"] = (u["first_name"] + l).lower() + str(random.randint(1, 999))
+    u["language_code"] = random.choice(langs)
+    if random.random() < .1: u["is_premium"] = True
+    return u
+def chat(u):
+    c = {"id": u["id"], "type": "private", "first_name": u["first_name"]}
+    if "last_name" in u: c["last_name"] = u["last_name"]
+    if "username" in u: c["username"] = u["username"]
+    return c
+def message(uid, text):
+    u = user(uid)
+    m = {"message_id": random.randint(1, 200000), "from": u, "chat": chat(u), "date": 1710000000 + random.randint(0, 20000000), "text": text}
+    if text.startswith("/"): m["entities"] = [{"type": "bot_command", "offset": 0, "length": len(text)}]
+    elif text.startswith("http"): m["entities"] = [{"type": "url", "offset": 0, "length": len(text)}]
+    return m
+def repo(): return random.choice(owners) + "/" + random.choice(names)
+def callback(uid):
+    rid = random.randint(1000, 900000000)
+    bot = {"id": 6000000000 + 123, "is_bot": True, "first_name": "GitWatcherBot", "username": "GitWatcherBot"}
+    kb = [[{"text": "Yes, unwatch " + repo(), "callback_data": f"unwatch_repo|{uid}|{rid}"}],[{"text": "Cancel", "callback_data": f"unwatch_repo_cancel|{uid}|{rid}"}]]
+    u = user(uid)
+    msg = {"message_id": random.randint(1, 200000), "from": bot, "chat": chat(u), "date": 1710000000 + random.randint(0, 20000000),
+           "text": "Are you sure you want to unwatch this repository?", "reply_markup": {"inline_keyboard": kb}}
+    return {"id": str(random.getrandbits(63)), "from": u, "message": msg, "chat_instance": str(random.getrandbits(63) - 2**62), "data": random.choice(["unwatch_repo", "unwatch_repo_cancel"]) + f"|{uid}|{rid}"}
+# GitHub's 5xx "Unicorn" page as returned in res.text (embedded image left out), a json parsing error logs it
+CSS = "".join(f".c{i}{{margin:{i % 7}px;padding:{i % 5}px;font-family:-apple-system,BlinkMacSystemFont,'Segoe UI',Helvetica,Arial,sans-serif;color:#{(i * 2654435761) % 0xffffff:06x}}}\n" for i in range(40))
+UNICORN = f"""<!DOCTYPE html>
+<!--
+
+Hello future GitHubber! I bet you're here to remove those nasty inline styles,
+DRY up these templates and make 'em nice and re-usable, right?
+
+Please, don't. https://github.com/styleguide/templates/2.0
+
+-->
+<html>
+  <head>
+    <meta http-equiv="Content-Type" content="text/html; charset=utf-8">
+    <title>Unicorn! &middot; GitHub</title>
+    <style type="text/css" media="screen">
+{CSS}    </style>
+  </head>
+  <body>
+    <div class="container">
+      <p><strong>We couldn't respond to your request in time.</strong></p>
+      <p>Sorry about that. Please try refreshing and contact us if the problem persists.</p>
+      <div id="suggestions"><a href="https://support.github.com/contact">Contact Support</a> &mdash; <a href="https://githubstatus.com">GitHub Status</a> &mdash; <a href="https://twitter.com/githubstatus">@githubstatus</a></div>
+      <p class="request-id">Request ID: REQID</p>
+    </div>
+  </body>
+</html>
+"""
+def record():
+    uid = random.randint(10000000, 7000000000)
+    r = random.random()
+    if r < .45:
+        return "TRACE", "onCommand", json.dumps(message(uid, random.choice(cmds)), separators=(",", ":"))
+    if r < .65:
+        t = repo() if random.random() < .6 else "https://github.com/" + repo()
+        return "TRACE", "onNonCommandMessage", json.dumps(message(uid, t), separators=(",", ":"))
+    if r < .80:
+        return "INFO", f"Repo {random.randint(1000,900000000)} successfully removed from user {uid} watch list", json.dumps(callback(uid), separators=(",", ":"))
+    if r < .90:
+        n = random.choice([
+            f"User {uid} has blocked the Bot.",
+            f"New user {uid} ({random.choice(first)}) started the bot",
+            f"Failed to add repo {repo()} to watch list for user id {uid}\nReason: Failed to get Repository '{repo()}': Bad credentials",
+            f"Watchdog cycle done: {random.randint(100,12000)} repositories, {random.randint(0,900)} changed, {random.randint(0,3000)} alerts in {random.randint(20,900)}s",
+            "Github API Rate Limit Exceeded :( Going to sleep and try again later"])
+        return "INFO", "Admin Notification", n
+    if r < .95:
+        return "ERROR", "Github Api json parsing error: [json.exception.parse_error.101] parse error at line 1, column 1: syntax error while parsing value - invalid literal; last read: '<'", UNICORN.replace("REQID", "%04X:%X:%X:%X:%X" % tuple(random.getrandbits(24) for _ in range(5)))
+    e = {"type": random.choice(["FORBIDDEN", "INTERNAL", "SERVICE_UNAVAILABLE"]), "path": ["r%d" % random.randint(0, 99)], "extensions": {"saml_failure": False},
+         "locations": [{"line": 1, "column": random.randint(100, 9000)}], "message": f"Although you appear to have the correct authorization credentials, the `{random.choice(owners)}` organization has enabled OAuth App access restrictions, meaning that data access to third-parties is limited."}
+    return "WARN", "Github GraphQL Api error: " + e["message"], json.dumps(e)
+for _ in range(N):
+    severity, shortMessage, longMessage = record()
+    print(json.dumps({"severity": severity, "shortMessage": shortMessage, "longMessage": longMessage}, ensure_ascii=False))
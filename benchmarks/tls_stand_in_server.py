@@ -0,0 +1,40 @@
+#!/usr/bin/env python3
+# Local HTTPS stand-in for api.github.com, answers every GET with a small repository JSON over keep-alive connections.
+# Usage: tls_stand_in_server.py [port]  (creates a self-signed certificate in the temp directory with openssl on first run)
+import http.server
+import os
+import ssl
+import subprocess
+import sys
+import tempfile
+
+BODY = b'{"id":1,"full_name":"torvalds/linux","stargazers_count":1,"forks_count":1,"open_issues_count":1}'
+DIR = tempfile.gettempdir()
+CERT, KEY = os.path.join(DIR, "stand_in_cert.pem"), os.path.join(DIR, "stand_in_key.pem")
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"  # keep connections alive
+    disable_nagle_algorithm = True  # headers and body are written separately, don't let them wait on delayed ACKs
+
+    def do_GET(self):
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(BODY)))
+        self.end_headers()
+        self.wfile.write(BODY)
+
+    def log_message(self, *args):
+        pass
+
+
+if not os.path.exists(CERT):
+    subprocess.run(["openssl", "req", "-x509", "-newkey", "rsa:2048", "-nodes", "-days", "30", "-subj", "/CN=localhost",
+                    "-keyout", KEY, "-out", CERT], check=True, capture_output=True)
+port = int(sys.argv[1]) if len(sys.argv) > 1 else 8443
+server = http.server.ThreadingHTTPServer(("127.0.0.1", port), Handler)
+context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+context.load_cert_chain(CERT, KEY)
+server.socket = context.wrap_socket(server.socket, server_side=True)
+print(f"Serving https://127.0.0.1:{port}/")
+server.serve_forever()
@@ -1,37 +1,61 @@
 #include "GitBot.hpp"
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <exception>
+#include <limits>
 #include <memory>
+#include <optional>
 #include <regex>
 #include <sstream>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <source_location>
 #include "db/Database.hpp"
+#include "db/RepoUpdatesBuffer.hpp"
 #include "log/Logger.hpp"
+#include "utils/BlockingQueue.hpp"
+#include "utils/FinalAction.hpp"
 
 using namespace tgbotxx;
 
-/// Constructor loads Bot token from res/BOT_TOKEN.txt and admin user id from res/ADMIN_USER_ID.txt
+/// Constructor loads Bot token from res/BOT_TOKEN.txt, admin user id from res/ADMIN_USER_ID.txt
+/// and watchdog in-flight requests from res/WATCHDOG_MAX_IN_FLIGHT_REQUESTS.txt if it exists
 GitBot::GitBot() : Bot(tgbotxx::FileUtils::read(fs::path(RES_DIR) / "BOT_TOKEN.txt")) {
   m_adminUserId = StringUtils::to<UserId>(FileUtils::read(fs::path(RES_DIR) / "ADMIN_USER_ID.txt"));
+  if (const fs::path maxInFlightFile = fs::path(RES_DIR) / "WATCHDOG_MAX_IN_FLIGHT_REQUESTS.txt"; fs::exists(maxInFlightFile)) {
+    m_watchdogMaxInFlightRequests = std::max<std::size_t>(1, StringUtils::to<std::size_t>(FileUtils::read(maxInFlightFile)));
+  }
 }
 
 void GitBot::onStart() {
   LOGI("Starting bot");
 
+  // Middleware and watchdog check users statuses from memory
+  Database::loadUsersCache();
+
   // Drop pending updates
   api()->deleteWebhook(true);
   // Set long polling timeout to 5 minutes, so Telegram server can hold the request for up to 5 minutes when
   // there are no updates
   api()->setLongPollTimeout(cpr::Timeout(std::chrono::seconds(300)));
 
-  // Init thread pool so we can handle multiple requests simultaneously
-  m_threadPool = std::make_unique<cpr::ThreadPool>();
-  m_threadPool->SetMinThreadNum(0); // Join all threads when there is no work to do
-  m_threadPool->SetMaxThreadNum(std::thread::hardware_concurrency()); // spawn up to CPU cors workers
-  m_threadPool->SetMaxIdleTime(std::chrono::milliseconds(86400000)); // Idle up to a day waiting for work to do
-  m_threadPool->Start(0); // No threads should be started by default until there is work to do
+  // Init executor so we can handle multiple requests simultaneously, commands and buttons go ahead of background work
+  m_executor = std::make_unique<Executor>(Executor::Options{
+    .onError = [](std::exception_ptr error) {
+      try {
+        std::rethrow_exception(error);
+      } catch (const std::exception &err) {
+        LOGE("Unhandled exception in executor task: " << err.what());
+      } catch (...) {
+        LOGE("Unhandled unknown exception in executor task");
+      }
+    },
+  });
+
+  // Init outbound messages dispatcher, all messages to users go through it
+  m_telegramDispatcher = std::make_unique<TelegramDispatcher>();
 
   // Register my commands
   Ptr<BotCommand> start(new BotCommand());
@@ -50,6 +74,8 @@ void GitBot::onStart() {
 
   // Create GitHub Api
   m_gitApi = std::make_unique<GitApi>();
+  LOGI("GitHub Api poll capacity: " << m_gitApi->tokenPool().capacity() << " requests an hour with " << m_gitApi->tokenPool().size()
+                                    << (m_gitApi->tokenPool().authenticated() ? " access token(s)" : " unauthenticated client"));
 
   // Create Watchdog thread, which will check for repository changes by the hour
   m_watchdogThread = std::make_unique<std::thread>(&GitBot::watchDog, this);
@@ -60,21 +86,30 @@ void GitBot::onStart() {
 
 void GitBot::onStop() {
   LOGI("Stopping bot");
+  m_stopping = true;
+  m_longPollCv.notify_all(); // don't wait for a long poll error backoff
   notifyAdmin("Stopping Bot...");
 
   // Stop watchdog thread
   m_watchdogRunning = false;
   m_watchdogCv.notify_one(); // waky waky
+  if (m_gitApi) m_gitApi->tokenPool().stop(); // wake up fetchers waiting for rate limit budget
   if (m_watchdogThread && m_watchdogThread->joinable()) {
     m_watchdogThread->join();
   }
 
-  // Notify admin that the bot has stopped, but before threadPool is stopped since
-  // sendSafeMessage uses the m_threadPool.
+  // Notify admin that the bot has stopped, but before the dispatcher is stopped since
+  // safeSendMessage queues to m_telegramDispatcher.
   notifyAdmin("Bot Stopped.");
 
-  // Stop the thread pool
-  m_threadPool->Stop();
+  // Finish the queued requests (they may still queue messages to m_telegramDispatcher)
+  m_executor->stop();
+
+  // Send what's still queued (for a few seconds at most)
+  m_telegramDispatcher->stop();
+
+  // Save queued logs
+  LogWriter::instance().stop();
 }
 
 // Returns true if str is a repository full name e.g "torvalds/linux"
@@ -114,14 +149,14 @@ bool GitBot::middleware(const tgbotxx::Ptr<tgbotxx::Message> &message) {
   if(message->text == "/start") return true;
 
   // User must exist in the database
-  if (not Database::userExists(message->from->id)) {
+  const std::optional<models::UserStatus> userStatus = Database::getUserStatus(message->from->id);
+  if (not userStatus) {
     safeSendMessage(message->from->id, "Send a /start command first to start interacting with the Bot.");
     return false;
   }
 
   // User status is Banned.
-  const models::UserStatus userStatus = Database::getUserStatus(message->from->id);
-  switch (userStatus) {
+  switch (*userStatus) {
     case UserStatus::ACTIVE:
       [[likely]]
       break;
@@ -145,7 +180,7 @@ void GitBot::onCommand(const Ptr<Message> &message) {
   if (!middleware(message)) return;
 
   /// Handle command simultaneously
-  m_threadPool->Submit([this, message]() -> void {
+  const bool accepted = m_executor->submit([this, message]() -> void {
     LOGT2("onCommand", message->toJson().dump());
 
     if (message->text == "/start") {
@@ -158,12 +193,16 @@ void GitBot::onCommand(const Ptr<Message> &message) {
       this->onUnwatchRepoCommand(message);
     }
 
-  });
+  }, TaskPriority::Interactive);
+  if (not accepted) {
+    LOGW("Executor is busy, rejected command " << message->text << " of user " << message->from->id);
+    safeSendMessage(message->from->id, "The bot is busy right now, please try again in a moment.");
+  }
 }
 
 void GitBot::onCallbackQuery(const tgbotxx::Ptr<tgbotxx::CallbackQuery> &callbackQuery) {
   /// Handle callbackQuery simultaneously
-  m_threadPool->Submit([callbackQuery, this]() -> void {
+  const bool accepted = m_executor->submit([callbackQuery, this]() -> void {
     const auto parts = StringUtils::split(callbackQuery->data, '|');
     if(parts.size() != 3) {
       safeSendMessage(callbackQuery->from->id, "Invalid Action. Please try again later.");
@@ -201,7 +240,11 @@ void GitBot::onCallbackQuery(const tgbotxx::Ptr<tgbotxx::CallbackQuery> &callbac
         // ignore If button clicked many times, what():  Bad Request: message to delete not found
       }
     }
-  });
+  }, TaskPriority::Interactive);
+  if (not accepted) {
+    LOGW("Executor is busy, rejected callback query " << callbackQuery->data << " of user " << callbackQuery->from->id);
+    safeSendMessage(callbackQuery->from->id, "The bot is busy right now, please try again in a moment.");
+  }
 }
 
 void GitBot::onNonCommandMessage(const Ptr<tgbotxx::Message> &message) {
@@ -219,23 +262,28 @@ void GitBot::onNonCommandMessage(const Ptr<tgbotxx::Message> &message) {
   if (not repoFullName.empty()) { // It's a repo full name.
     try {
       // First, check if user has not exceeded the maximum repos in watch list (we can't afford GitHub Api rate limit on too many repos...)
-      const int userReposCount = Database::userReposCount(message->from->id);
-      if (userReposCount >= kMaxWatchListRepositories) {
+      const std::size_t userReposCount = Database::userReposCount(message->from->id);
+      const std::size_t maxWatchListRepositories = this->maxWatchListRepositories();
+      if (userReposCount >= maxWatchListRepositories) {
         safeSendMessage(message->from->id, "You have reached the maximum watch list repositories " + std::to_string(userReposCount) + "/" +
-                                           std::to_string(kMaxWatchListRepositories) + ". This limit is set due to avoid Github Api Rate Limit for the Bot :(");
+                                           std::to_string(maxWatchListRepositories) + ". This limit is set due to avoid Github Api Rate Limit for the Bot :(");
         return;
       }
 
       // Check if the new repository was already added to user's watch list
-      if (Database::repoExistsByFullName(repoFullName)) {
+      if (Database::userWatchesRepoByFullName(message->from->id, repoFullName)) {
         safeSendMessage(message->from->id, "Repository " + repoFullName + " was already added to your watch list.");
         return;
       }
 
-      // All good until here! Let's add new repository to user's watch list
-      Repository newRepo = m_gitApi->getRepository(repoFullName);
-      newRepo.watcher_id = std::make_unique<UserId>(message->from->id);
-      Database::addRepo(newRepo);
+      // All good until here! Let's add new repository to user's watch list, it's only fetched if no other user watches it yet
+      std::optional<Repository> watchedRepo = Database::findRepoByFullName(repoFullName);
+      Repository newRepo = watchedRepo ? std::move(*watchedRepo) : m_gitApi->getRepository(repoFullName);
+      if (not watchedRepo) {
+        newRepo.poll_interval = kDefaultPollInterval.count();
+        newRepo.next_poll_at = std::time(nullptr) + newRepo.poll_interval;
+      }
+      Database::addUserRepo(message->from->id, newRepo);
 
       safeSendMessage(message->from->id, "Repository " + newRepo.full_name + " added to watch list.");
       notifyAdmin("Repository " + newRepo.full_name + " added to watch list for user " + message->from->username);
@@ -264,12 +312,22 @@ void GitBot::onLongPollError(const std::string &errorMessage, ErrorCode errorCod
     case ErrorCode::SEE_OTHER:
     case ErrorCode::FLOOD:
     case ErrorCode::TOO_MANY_REQUESTS:
-    case ErrorCode::BAD_GATEWAY:
-      LOGE("Sleeping Bot for 10s due error code: " << errorCode);
+    case ErrorCode::BAD_GATEWAY: {
       /// It's usually network issue or Telegram servers are not responding.
-      /// So we wait 10s and try again.
-      std::this_thread::sleep_for(std::chrono::seconds(10));
+      /// So we back off before long polling again, longer as errors repeat. tgbotxx polls again as soon as we return,
+      /// so the polling thread waits out the backoff here, interrupted only if Bot is stopping.
+      const auto now = std::chrono::steady_clock::now();
+      if (now - m_lastLongPollErrorAt > kLongPollErrorsReset) m_longPollErrors = 0;
+      m_lastLongPollErrorAt = now;
+      std::chrono::milliseconds delay = kLongPollBackoff.delay(++m_longPollErrors);
+      if (std::optional<std::chrono::seconds> retryAfter = TelegramDispatcher::retryAfter(errorMessage)) {
+        delay = std::max<std::chrono::milliseconds>(delay, *retryAfter);
+      }
+      LOGE("Backing off long polling for " << delay.count() << "ms due error code: " << errorCode);
+      std::unique_lock<std::mutex> lock(m_sleepMutex);
+      m_longPollCv.wait_for(lock, delay, [this] { return m_stopping.load(); });
       break;
+    }
     default:
       break;
   }
@@ -278,54 +336,46 @@ void GitBot::onLongPollError(const std::string &errorMessage, ErrorCode errorCod
   notifyAdmin("Long poll error: " + errorMessage);
 }
 
+std::size_t GitBot::maxWatchListRepositories() const {
+  // kMaxWatchListRepositories is what the 60 requests an hour of an unauthenticated client can afford, scale it with the pool capacity
+  const auto capacity = static_cast<std::size_t>(m_gitApi->tokenPool().capacity());
+  return std::clamp(kMaxWatchListRepositories * capacity / TokenPool::kUnauthenticatedRateLimit, kMaxWatchListRepositories, kMaxWatchListRepositoriesCap);
+}
+
 void GitBot::watchDog() {
   m_watchdogRunning = true;
+  std::time_t lastBackup = std::time(nullptr);
   while (m_watchdogRunning) {
+    // Wake up at least every kDefaultPollInterval so newly added repositories are picked up in time
+    std::time_t nextPollAt = std::time(nullptr) + kDefaultPollInterval.count();
     try {
-      Database::iterateRepos([this](const models::Repository &localRepo) {
-        if (Database::getUserStatus(*localRepo.watcher_id) != UserStatus::ACTIVE)
-          // Skip repositories that belong to users who blocked the bot and banned users.
+      // Each repository is fetched once per cycle and its changes are fanned out to all of its watchers.
+      // Only repositories that are due are polled, each repository has its own adaptive polling interval.
+      const std::time_t now = std::time(nullptr);
+      std::unordered_map<models::RepositoryId, std::vector<UserId>> reposWatchers = Database::getReposWatchers();
+      std::vector<WatchedRepository> watchList{};
+      Database::iterateRepos([&reposWatchers, &watchList, &nextPollAt, now](const models::Repository &localRepo) {
+        auto it = reposWatchers.find(localRepo.id);
+        if (it == reposWatchers.end()) return;
+        // Skip users who blocked the bot and banned users.
+        std::vector<UserId> &watchers = it->second;
+        std::erase_if(watchers, [](const UserId watcherId) { return Database::getUserStatus(watcherId) != UserStatus::ACTIVE; });
+        if (watchers.empty()) return;
+        if (localRepo.next_poll_at > now) {
+          nextPollAt = std::min(nextPollAt, localRepo.next_poll_at);
           return;
-
-        models::Repository remoteRepo = m_gitApi->getRepository(localRepo.full_name);
-
-        /// Stars
-        if (remoteRepo.stargazers_count != localRepo.stargazers_count) {
-          alertUserRepositoryStarsChange(*localRepo.watcher_id, remoteRepo.full_name, localRepo.stargazers_count,
-                                         remoteRepo.stargazers_count);
-        }
-        /// Watchers
-        if (remoteRepo.watchers_count != localRepo.watchers_count) {
-          alertUserRepositoryWatchersChange(*localRepo.watcher_id, remoteRepo.full_name, localRepo.watchers_count,
-                                            remoteRepo.watchers_count);
-        }
-        /// Issues
-        if (remoteRepo.open_issues_count != localRepo.open_issues_count) {
-          alertUserRepositoryIssuesChange(*localRepo.watcher_id, remoteRepo.full_name, localRepo.open_issues_count,
-                                          remoteRepo.open_issues_count);
-        }
-        /// Pull requests
-        if (remoteRepo.pulls_count != localRepo.pulls_count) {
-          alertUserRepositoryPullRequestsChange(*localRepo.watcher_id, remoteRepo.full_name, localRepo.pulls_count,
-                                                remoteRepo.pulls_count);
         }
-        /// Forks
-        if (remoteRepo.forks_count != localRepo.forks_count) {
-          alertUserRepositoryForksChange(*localRepo.watcher_id, remoteRepo.full_name, localRepo.forks_count,
-                                         remoteRepo.forks_count);
-        }
-
-        // Update local db repo
-        remoteRepo.watcher_id = std::make_unique<UserId>(*localRepo.watcher_id);
-        Database::updateRepo(remoteRepo);
-
-        // Little nap before next repo check to not get banned by GitHub Api
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        watchList.push_back(WatchedRepository{.repo = localRepo, .watchers = std::move(watchers)});
       });
+      LOGI("Watchdog checking " << watchList.size() << " repositories due for polling");
+
+      nextPollAt = std::min(nextPollAt, pollRepositories(watchList));
+      LOGI("Telegram outbound queue depth: " << m_telegramDispatcher->queueDepth() << " messages");
+      LOGI("Executor: " << m_executor->stats());
 
     } catch (const GitApiRateLimitExceededException &err) {
       LOGW(err.what());
-      notifyAdmin("Github API Rate Limit Exceeded :( Going to sleep and try again next hour");
+      notifyAdmin("Github API Rate Limit Exceeded :( Going to sleep and try again later");
     }
     catch (const std::exception &e) {
       LOGE(e.what());
@@ -333,21 +383,15 @@ void GitBot::watchDog() {
     }
 
     {
-      // Save db backup before going to sleep every hour
-      Database::backup();
-
-      // To check for repo updates every clock hour, which means code will check
-      // at 7:00am 8:00am 9:00am...
-      // Get the current time
-      const auto now = std::chrono::system_clock::now();
-      const auto now_c = std::chrono::system_clock::to_time_t(now);
-      const std::tm now_tm = *std::localtime(&now_c);
-      // Calculate the time until the start of the next clock hour
-      const auto nextHour = now + std::chrono::hours(1) - std::chrono::minutes(now_tm.tm_min) - std::chrono::seconds(now_tm.tm_sec);
-      // Calculate the remaining time until the next hour
-      const auto remainingTime = nextHour - now;
-      // Sleep until the next hour
-      LOGI("Watchdog Sleeping for " << std::chrono::duration_cast<std::chrono::minutes>(remainingTime).count() << " minutes until next hour");
+      // Save db backup every hour
+      if (std::time(nullptr) - lastBackup >= kBackupInterval.count()) {
+        Database::backup();
+        lastBackup = std::time(nullptr);
+      }
+
+      // Sleep until the next repository is due
+      const auto remainingTime = std::chrono::seconds(std::max<std::time_t>(kWatchdogMinSleep.count(), nextPollAt - std::time(nullptr)));
+      LOGI("Watchdog Sleeping for " << std::chrono::duration_cast<std::chrono::minutes>(remainingTime).count() << " minutes until next repository is due");
       // Go to sleep, but wake up if m_watchdogCv got notified and check if m_watchdogRunning.
       std::unique_lock<std::mutex> lock(m_sleepMutex);
       m_watchdogCv.wait_for(lock, remainingTime, [this] { return not m_watchdogRunning.load(); });
@@ -356,172 +400,352 @@ void GitBot::watchDog() {
   }
 }
 
-void GitBot::alertUserRepositoryStarsChange(UserId userId, const std::string &repositoryName, std::int64_t oldStarsCount,
-                                            std::int64_t newStarsCount) {
+std::time_t GitBot::scheduleNextPoll(models::Repository &repo, const bool changed) {
+  const std::time_t now = std::time(nullptr);
+  std::int64_t interval = repo.poll_interval > 0 ? repo.poll_interval : kDefaultPollInterval.count();
+  // Active repositories get polled more often, dormant ones less often
+  interval = changed ? interval / 2 : interval * 3 / 2;
+  interval = std::clamp<std::int64_t>(interval, kMinPollInterval.count(), kMaxPollInterval.count());
+
+  repo.poll_interval = interval;
+  repo.next_poll_at = now + interval;
+  if (changed) repo.last_changed_at = now;
+  return repo.next_poll_at;
+}
+
+std::time_t GitBot::pollRepositories(std::vector<WatchedRepository> &watchList) {
+  /// Result of fetching a single repository, passed from the fetch stage to the diff stage
+  struct FetchResult {
+    WatchedRepository *local{};
+    std::optional<models::Repository> remoteRepo{};
+    bool notModified{}; ///<! GitHub replied 304 Not Modified, the local snapshot is up to date
+    std::exception_ptr error{};
+  };
+
+  std::vector<WatchedRepository *> jobs{};
+  jobs.reserve(watchList.size());
+  for (WatchedRepository &watchedRepo: watchList)
+    jobs.push_back(&watchedRepo);
+  std::time_t nextPollAt = std::numeric_limits<std::time_t>::max();
+  if (jobs.empty()) return nextPollAt;
+
+  // With access tokens, fetch repositories in batches with a single GraphQL query per batch instead of one REST request per repository
+  const bool useGraphQL = m_gitApi->tokenPool().authenticated();
+  const std::size_t batchSize = useGraphQL ? GitApi::kGraphQLBatchSize : 1;
+  const std::size_t batchesCount = (jobs.size() + batchSize - 1) / batchSize;
+  const GitTokenBudget budget = useGraphQL ? &GitToken::graphqlRateLimiter : &GitToken::rateLimiter;
+
+  BlockingQueue<FetchResult> results(m_watchdogMaxInFlightRequests * batchSize * 2);
+  std::atomic<std::size_t> nextBatch{0};
+  const std::size_t fetchersCount = std::min(m_watchdogMaxInFlightRequests, batchesCount);
+  std::atomic<std::size_t> activeFetchers{fetchersCount};
+
+  /// Fetches open pull requests count of remoteRepo if a token has search budget right now, otherwise it's left for a later cycle
+  auto refreshPullsCount = [this](models::Repository &remoteRepo) -> void {
+    GitToken *searchToken = m_gitApi->tokenPool().tryAcquire(&GitToken::searchRateLimiter);
+    if (not searchToken) return;
+    try {
+      remoteRepo.pulls_count = m_gitApi->getPullsCount(remoteRepo.full_name, *searchToken);
+      remoteRepo.pullsUpdatedAt = std::time(nullptr);
+    } catch (const GitApiRateLimitExceededException &err) {
+      LOGW(err.what());
+      searchToken->searchRateLimiter.limitExceeded();
+    } catch (const std::exception &err) {
+      LOGW("Failed to refresh pulls count of " << remoteRepo.full_name << ": " << err.what());
+    }
+  };
+
+  /// Fetches jobs [first, last) with the given token, REST: a single repository, GraphQL: a whole batch
+  auto fetch = [&](std::size_t first, std::size_t last, GitToken &token) -> std::vector<FetchResult> {
+    std::vector<FetchResult> batch{};
+    if (useGraphQL) {
+      std::vector<std::string> fullNames{};
+      for (std::size_t i = first; i < last; ++i)
+        fullNames.push_back(jobs[i]->repo.full_name);
+      std::vector<std::optional<models::Repository>> remoteRepos = m_gitApi->getRepositories(fullNames, token);
+      for (std::size_t i = first; i < last; ++i) {
+        FetchResult &result = batch.emplace_back(FetchResult{.local = jobs[i], .remoteRepo = std::move(remoteRepos[i - first])});
+        if (not result.remoteRepo) {
+          result.error = std::make_exception_ptr(GitApiRepositoryNotFoundException("Repository " + fullNames[i - first] + " not found"));
+        } else {
+          // GraphQL has no validators, keep the REST ones so saving the repository doesn't wipe them
+          result.remoteRepo->etag = jobs[i]->repo.etag;
+          result.remoteRepo->last_modified = jobs[i]->repo.last_modified;
+        }
+      }
+    } else {
+      FetchResult &result = batch.emplace_back(FetchResult{.local = jobs[first]});
+      const models::Repository &localRepo = jobs[first]->repo;
+      // A 304 proves the remote repository equals the snapshot the validators were taken from
+      result.remoteRepo = m_gitApi->getRepositoryIfModified(localRepo, token);
+      result.notModified = not result.remoteRepo.has_value();
+      // REST doesn't give us pulls count, refresh it with the search Api every kPullsCountRefreshInterval if search budget allows
+      if (result.remoteRepo and std::time(nullptr) - localRepo.pullsUpdatedAt >= kPullsCountRefreshInterval.count()) {
+        refreshPullsCount(*result.remoteRepo);
+      }
+    }
+    return batch;
+  };
+
+  /// Fetch stage: each fetcher keeps one GitHub request in flight, so at most fetchersCount requests are in flight at once.
+  /// Requests are paced by the GitApi tokens pool so the cycle spreads over the rate limit window instead of being cut short.
+  auto fetcher = [&]() -> void {
+    FinalAction done([&]() noexcept {
+      if (--activeFetchers == 0) results.close(); // last fetcher out closes the stage
+    });
+    for (std::size_t b = nextBatch++; b < batchesCount && m_watchdogRunning; b = nextBatch++) {
+      const std::size_t first = b * batchSize, last = std::min(first + batchSize, jobs.size());
+      std::vector<FetchResult> batch{};
+      for (bool retry = true; retry;) {
+        retry = false;
+        GitToken *token = m_gitApi->tokenPool().acquire(budget);
+        if (not token) return; // stopping
+        try {
+          batch = fetch(first, last, *token);
+        } catch (const GitApiRateLimitExceededException &err) {
+          // Token's budget was spent elsewhere (e.g users adding repositories), retry with another token or after reset
+          LOGW(err.what());
+          (token->*budget).limitExceeded();
+          retry = true;
+        } catch (...) {
+          batch.clear();
+          for (std::size_t i = first; i < last; ++i)
+            batch.push_back(FetchResult{.local = jobs[i], .error = std::current_exception()});
+        }
+      }
+      for (FetchResult &result: batch)
+        results.push(std::move(result));
+    }
+  };
+  std::vector<std::jthread> fetchers{};
+  fetchers.reserve(fetchersCount);
+  for (std::size_t i = 0; i < fetchersCount; ++i)
+    fetchers.emplace_back(fetcher);
+  // If the diff stage throws, unblock fetchers waiting on a full queue before they get joined
+  FinalAction closeResults([&results]() noexcept { results.close(); });
+
+  /// Diff stage: compare each fetched repository against its local snapshot, collect changes in its watchers digests and update the db.
+  /// Each watcher gets a single digest of the cycle, sent once the cycle ends (or throws) right after the last updates are saved.
+  /// Changes of a repository are rendered once and the same section is shared by the digests of all of its watchers.
+  std::unordered_map<UserId, std::vector<ChangesSection>> digests{};
+  FinalAction sendDigests([this, &digests]() noexcept {
+    for (const auto &[watcherId, sections]: digests) {
+      try {
+        std::string digest{};
+        std::size_t size = 0;
+        for (const ChangesSection &section: sections) size += section->size() + 1;
+        digest.reserve(size);
+        for (const ChangesSection &section: sections) {
+          if (not digest.empty()) digest += '\n';
+          digest += *section;
+        }
+        safeSendMessage(watcherId, std::move(digest)); // split at Telegram's message limit
+      } catch (const std::exception &e) {
+        LOGE("Failed to send changes digest to user id " << watcherId << ": " << e.what());
+      }
+    }
+  });
+  /// Updates are written behind in batches, whatever is still pending is saved when the cycle ends (or throws).
+  RepoUpdatesBuffer repoUpdates{};
+  std::size_t checked{}, notModified{}, failed{};
+  while (std::optional<FetchResult> result = results.pop()) {
+    models::Repository &localRepo = result->local->repo;
+    if (result->error) {
+      try {
+        std::rethrow_exception(result->error);
+      } catch (const std::exception &e) {
+        ++failed;
+        LOGE("Failed to check repository " << localRepo.full_name << ": " << e.what());
+      }
+    }
+    if (result->error or result->notModified) {
+      if (result->notModified) {
+        ++checked;
+        ++notModified;
+      }
+      // back off failing repositories (e.g deleted) like dormant ones
+      nextPollAt = std::min(nextPollAt, scheduleNextPoll(localRepo, false));
+      repoUpdates.updateSchedule(localRepo);
+      continue;
+    }
+
+    models::Repository &remoteRepo = *result->remoteRepo;
+    if (remoteRepo.pullsUpdatedAt == 0) { // keep what we know until the next pulls count refresh
+      remoteRepo.pulls_count = localRepo.pulls_count;
+      remoteRepo.pullsUpdatedAt = localRepo.pullsUpdatedAt;
+    }
+    const ChangesSection changes = renderRepositoryChanges(localRepo, remoteRepo);
+    const bool changed = changes != nullptr;
+    if (changed) {
+      for (const UserId watcherId: result->local->watchers) {
+        digests[watcherId].push_back(changes);
+      }
+    }
+
+    // Update local db repo, a single row no matter how many users watch it
+    remoteRepo.createdAt = localRepo.createdAt;
+    remoteRepo.poll_interval = localRepo.poll_interval;
+    remoteRepo.last_changed_at = localRepo.last_changed_at;
+    nextPollAt = std::min(nextPollAt, scheduleNextPoll(remoteRepo, changed));
+    repoUpdates.update(remoteRepo);
+    ++checked;
+  }
+  fetchers.clear(); // join
+  repoUpdates.flush(); // the cycle's alerts are final once the new snapshots are saved
+
+  LOGI("Watchdog checked " << checked << '/' << jobs.size() << " repositories, " << notModified << " not modified, " << failed << " failed, "
+                            << digests.size() << " changes digests to send");
+  if (failed) {
+    notifyAdmin("Watchdog failed to check " + std::to_string(failed) + " repositories, see logs for details.");
+  }
+  return nextPollAt;
+}
+
+GitBot::ChangesSection GitBot::renderRepositoryChanges(const models::Repository &localRepo, const models::Repository &remoteRepo) {
   std::ostringstream oss{};
-  oss << "New change in " << repositoryName << "!\n";
+  oss << "New change in " << remoteRepo.full_name << "!\n";
+  const std::size_t headerSize = oss.view().size();
+  /// Stars
+  if (remoteRepo.stargazers_count != localRepo.stargazers_count) {
+    appendStarsChange(oss, localRepo.stargazers_count, remoteRepo.stargazers_count);
+  }
+  /// Watchers
+  if (remoteRepo.watchers_count != localRepo.watchers_count) {
+    appendWatchersChange(oss, localRepo.watchers_count, remoteRepo.watchers_count);
+  }
+  /// Issues
+  if (remoteRepo.open_issues_count != localRepo.open_issues_count) {
+    appendIssuesChange(oss, localRepo.open_issues_count, remoteRepo.open_issues_count);
+  }
+  /// Pull requests
+  if (remoteRepo.pulls_count != localRepo.pulls_count) {
+    appendPullRequestsChange(oss, localRepo.pulls_count, remoteRepo.pulls_count);
+  }
+  /// Forks
+  if (remoteRepo.forks_count != localRepo.forks_count) {
+    appendForksChange(oss, localRepo.forks_count, remoteRepo.forks_count);
+  }
+  if (oss.view().size() == headerSize) return nullptr;
+  return std::make_shared<const std::string>(std::move(oss).str());
+}
+
+void GitBot::appendStarsChange(std::ostream &oss, std::int64_t oldStarsCount, std::int64_t newStarsCount) {
   std::int64_t newStars = newStarsCount - oldStarsCount;
   if (newStars > 0) {
     oss << newStars << " New Star(s) ⭐ 😃\n";
   } else {
     oss << newStars << " Star(s) ⭐ 😢\n";
   }
-  oss << "Current stars " << newStarsCount << " ⭐";
-
-  safeSendMessage(userId, oss.str());
+  oss << "Current stars " << newStarsCount << " ⭐\n";
 }
 
-void GitBot::alertUserRepositoryWatchersChange(UserId userId, const std::string &repositoryName,
-                                               std::int64_t oldWatchersCount, std::int64_t newWatchersCount) {
-  std::ostringstream oss{};
-  oss << "New change in " << repositoryName << "!\n";
+void GitBot::appendWatchersChange(std::ostream &oss, std::int64_t oldWatchersCount, std::int64_t newWatchersCount) {
   std::int64_t newWatchers = newWatchersCount - oldWatchersCount;
   if (newWatchers > 0) {
     oss << newWatchers << " New Watcher(s) 👀\n";
   } else {
     oss << newWatchers << " Watcher(s) 😢\n";
   }
-  oss << "Current watchers " << newWatchersCount << " 👀";
-
-  safeSendMessage(userId, oss.str());
+  oss << "Current watchers " << newWatchersCount << " 👀\n";
 }
 
-void GitBot::alertUserRepositoryIssuesChange(UserId userId, const std::string &repositoryName, std::int64_t oldIssuesCount,
-                                             std::int64_t newIssuesCount) {
-  std::ostringstream oss{};
-  oss << "New change in " << repositoryName << "!\n";
+void GitBot::appendIssuesChange(std::ostream &oss, std::int64_t oldIssuesCount, std::int64_t newIssuesCount) {
   std::int64_t newIssues = newIssuesCount - oldIssuesCount;
   if (newIssues > 0) {
     oss << newIssues << " New Issue(s) 🐛\n";
   } else {
     oss << std::abs(newIssues) << " Issue(s) Closed 😃 🎉\n";
   }
-  oss << "Current issues " << newIssuesCount << " 🐛";
-
-  safeSendMessage(userId, oss.str());
+  oss << "Current issues " << newIssuesCount << " 🐛\n";
 }
 
-void GitBot::alertUserRepositoryForksChange(UserId userId, const std::string &repositoryName, std::int64_t oldForksCount,
-                                            std::int64_t newForksCount) {
-  std::ostringstream oss{};
-  oss << "New change in " << repositoryName << "!\n";
+void GitBot::appendForksChange(std::ostream &oss, std::int64_t oldForksCount, std::int64_t newForksCount) {
   std::int64_t newForks = newForksCount - oldForksCount;
   if (newForks > 0) {
     oss << newForks << " New Fork(s) 🍴\n";
   } else {
     oss << std::abs(newForks) << " Deleted Fork(s) 🍴\n";
   }
-  oss << "Current forks " << newForksCount << " 🍴";
-
-  safeSendMessage(userId, oss.str());
+  oss << "Current forks " << newForksCount << " 🍴\n";
 }
 
-
-void GitBot::alertUserRepositoryPullRequestsChange(UserId userId, const std::string &repositoryName, std::int64_t oldPullsCount,
-                                                   std::int64_t newPullsCount) {
-  std::ostringstream oss{};
-  oss << "New change in " << repositoryName << "!\n";
+void GitBot::appendPullRequestsChange(std::ostream &oss, std::int64_t oldPullsCount, std::int64_t newPullsCount) {
   std::int64_t newPulls = newPullsCount - oldPullsCount;
   if (newPulls > 0) {
     oss << newPulls << " New Pull Request(s) ⛙\n";
   } else {
     oss << std::abs(newPulls) << " Closed Pull Request(s) ⛙\n";
   }
-  oss << "Current pulls " << newPullsCount << " ⛙";
-
-  safeSendMessage(userId, oss.str());
+  oss << "Current pulls " << newPullsCount << " ⛙\n";
 }
 
 void GitBot::safeSendMessage(UserId userId, std::string messageText, std::int32_t messageThreadId, const std::string &parseMode, const std::vector<tgbotxx::Ptr<tgbotxx::MessageEntity>> &entities, bool disableWebPagePreview, bool disableNotification, bool protectContent, std::int32_t replyToMessageId, bool allowSendingWithoutReply, const Ptr<IReplyMarkup> &replyMarkup) {
   if (messageText.size() > kTelegramMessageMax) {
-    m_threadPool->Submit([this, userId, msg = std::move(messageText)]() -> void {
-      this->safeSendLargeMessage(userId, msg);
-    });
-  } else {
-    m_threadPool->Submit([=, this]() -> void {
-      using namespace std::chrono_literals;
-      Ptr<tgbotxx::Message> sentMsg{};
-      constexpr std::size_t MAX_ATTEMPTS = 5;
-      auto attemptSleep = 2s;
-      std::size_t attempt{};
-
-      do {
-        if (attempt != 0) {
-          LOGW("Attempt №" << attempt << " to send message to user ID: " << userId);
-          std::this_thread::sleep_for(attemptSleep);
-          attemptSleep++;
-        }
-        try {
-          sentMsg = api()->sendMessage(userId, messageText,
-                                       messageThreadId, parseMode, entities,
-                                       disableWebPagePreview, disableNotification,
-                                       protectContent, replyToMessageId,
-                                       allowSendingWithoutReply, replyMarkup);
-        } catch (const tgbotxx::Exception &e) {
-          if (std::string(e.what()) == "Forbidden: bot was blocked by the user") {
-            LOGW("Bot is blocked by user id: " << userId << " (" << e.what() << ")");
-            this->onUserBlockedBot(userId);
-            return;
-          }
-          LOGE("Can't send message: '" << messageText << "' to user id " << userId << " on attempt №" << attempt << ": " << e.what());
-        } catch (const std::exception &e) {
-          LOGE("Can't send message: '" << messageText << "' to user id " << userId << " on attempt №" << attempt << ": " << e.what());
-        }
-        catch (...) {
-          LOGE("Can't send message: '" << messageText << "' to user id " << userId << " on attempt №" << attempt);
-        }
-      } while ((sentMsg == nullptr) && (++attempt <= MAX_ATTEMPTS));
-    });
+    safeSendLargeMessage(userId, messageText);
+    return;
   }
+  // Queued to the dispatcher which paces messages to Telegram limits and retries failed ones
+  m_telegramDispatcher->send(userId, [=, this, messageText = std::move(messageText)]() -> void {
+    try {
+      api()->sendMessage(userId, messageText,
+                         messageThreadId, parseMode, entities,
+                         disableWebPagePreview, disableNotification,
+                         protectContent, replyToMessageId,
+                         allowSendingWithoutReply, replyMarkup);
+    } catch (const tgbotxx::Exception &e) {
+      if (std::string(e.what()) == "Forbidden: bot was blocked by the user") {
+        LOGW("Bot is blocked by user id: " << userId << " (" << e.what() << ")");
+        this->onUserBlockedBot(userId);
+        return;
+      }
+      throw; // retried by the dispatcher
+    }
+  });
 }
 
 void GitBot::safeSendLargeMessage(UserId userId, const std::string &messageText) {
-  if (messageText.size() > kTelegramMessageMax) {
-    std::vector<std::string_view> msgChunks;
-    // Split the message into chunks
-    for (std::size_t i = 0; i < messageText.size(); i += kTelegramMessageMax) {
-      msgChunks.emplace_back(messageText.data() + i, std::min(kTelegramMessageMax, messageText.size() - i));
-    }
-    // Send each chunk as a reply
-    LOGT("Sending large message of " << messageText.size() << " bytes partially in " << msgChunks.size() << " chunks");
-    for (const std::string_view &chunk: msgChunks) {
-      Ptr<tgbotxx::Message> sent{nullptr};
-      std::size_t attempt = 0;
-      constexpr std::size_t MAX_ATTEMPTS = 5;
-      do {
-        if (attempt != 0)
-          std::this_thread::sleep_for(std::chrono::seconds(1));
-        try {
-          sent = api()->sendMessage(userId, std::string{chunk});
-        } catch (const tgbotxx::Exception &e) {
-          if (std::string(e.what()) == "Forbidden: bot was blocked by the user") {
-            LOGW("Bot is blocked by user id: " << userId << " (" << e.what() << ")");
-            this->onUserBlockedBot(userId);
-            return;
-          }
-          LOGE("Can't send message: '" << messageText << "' to user id " << userId << " on attempt №" << attempt << ": " << e.what());
-        } catch (const std::exception &e) {
-          LOGE("Can't send message: '" << messageText << "' to user id " << userId << " on attempt №" << attempt << ": " << e.what());
-        }
-        catch (...) {
-          LOGE("Can't send message: '" << messageText << "' to user id " << userId << " on attempt №" << attempt);
-        }
-      } while (not sent && (++attempt <= MAX_ATTEMPTS));
-    }
-  } else {
-    safeSendMessage(userId, messageText);
+  // Split the message into chunks, they are sent in order since they are queued to the same chat
+  const std::vector<std::string_view> chunks = splitMessage(messageText, kTelegramMessageMax);
+  LOGT("Sending large message of " << messageText.size() << " bytes partially in " << chunks.size() << " chunks");
+  for (const std::string_view chunk: chunks) {
+    safeSendMessage(userId, std::string{chunk});
   }
+}
 
+std::vector<std::string_view> GitBot::splitMessage(std::string_view text, std::size_t maxSize) {
+  std::vector<std::string_view> chunks{};
+  while (text.size() > maxSize) {
+    // Cut after the last line that fits, or else before the last UTF-8 character that fits
+    std::size_t size = text.rfind('\n', maxSize - 1) + 1;
+    if (size == 0) {
+      size = maxSize;
+      while (size > 1 and (static_cast<unsigned char>(text[size]) & 0xC0) == 0x80) --size; // continuation byte
+    }
+    chunks.push_back(text.substr(0, size));
+    text.remove_prefix(size);
+  }
+  if (not text.empty()) chunks.push_back(text);
+  return chunks;
 }
 
 void GitBot::onUserBlockedBot(const UserId userId) {
-  m_threadPool->Submit([this, userId] -> void {
+  auto markBlocked = [this, userId]() -> void {
     // Update user status from anything to BLOCKED_BOT
     Database::updateUserStatus(userId, models::UserStatus::BLOCKED_BOT);
     // User will be ACTIVE again when he/she sends /start command.
 
     notifyAdmin("User " + std::to_string(userId) + " has blocked the Bot.");
-  });
+  };
+  if (not m_executor->submit(markBlocked)) {
+    // Executor is busy, or stopped while the dispatcher is still draining on stop. The status must not be lost,
+    // update it from the dispatcher thread then, it's a single write queued to the database writer thread.
+    LOGW("Executor rejected blocked Bot status update of user " << userId << ", updating it inline");
+    try {
+      markBlocked();
+    } catch (const std::exception &err) {
+      LOGE("Failed to update status of user " << userId << " who blocked the Bot: " << err.what());
+    }
+  }
 }
 
 void GitBot::onStartCommand(const tgbotxx::Ptr<tgbotxx::Message> message) {
@@ -582,7 +806,7 @@ void GitBot::onUnwatchRepoCommand(const tgbotxx::Ptr<tgbotxx::Message> message)
     std::vector<Ptr<InlineKeyboardButton>> row;
     Ptr<InlineKeyboardButton> btn(new InlineKeyboardButton());
     btn->text = repo.full_name;
-    std::string callbackData = "unwatch_repo|" + std::to_string(*repo.watcher_id) + "|" + std::to_string(repo.id); // bcz of the limit 1-64 byte, minimize it (todo callbackData sqlite table, put id here and fill any size in db)
+    std::string callbackData = "unwatch_repo|" + std::to_string(userId) + "|" + std::to_string(repo.id); // bcz of the limit 1-64 byte, minimize it (todo callbackData sqlite table, put id here and fill any size in db)
     btn->callbackData = callbackData;
     row.push_back(btn);
     keyboard->inlineKeyboard.push_back(row);
@@ -1,11 +1,20 @@
 #pragma once
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
 #include <tgbotxx/tgbotxx.hpp>
 #include <type_traits>
+#include <unordered_map>
+#include <vector>
 #include "api/GitApi.hpp"
-#include <cpr/threadpool.h>
+#include "api/TelegramDispatcher.hpp"
+#include "utils/Backoff.hpp"
+#include "utils/Executor.hpp"
 
 /// @brief Bot class 
 class GitBot : public tgbotxx::Bot {
@@ -34,7 +43,9 @@ private:
   void onNonCommandMessage(const tgbotxx::Ptr<tgbotxx::Message> &message) override;
   /// @brief Called back when a button was clicked by the user, providing us with the payload we assigned the button.
   void onCallbackQuery(const tgbotxx::Ptr<tgbotxx::CallbackQuery> &callbackQuery) override;
-  /// @brief Called when an issue happened with the long polling (network issues for example)
+  /// @brief Called when an issue happened with the long polling (network issues for example).
+  /// Runs on tgbotxx's polling thread, which polls again as soon as it returns, so it waits out an interruptible jittered backoff
+  /// (kLongPollBackoff, or Telegram's retry after if longer) that onStop() cuts short.
   void onLongPollError(const std::string &errorMessage, tgbotxx::ErrorCode errorCode) override;
 
   /// @brief Command handlers
@@ -48,19 +59,43 @@ private:
   void onUserBlockedBot(const UserId userId);
 
 private:
+  /// @brief A repository due for polling with its active watchers
+  struct WatchedRepository {
+    models::Repository repo; ///<! Last known snapshot, shared by all of its watchers
+    std::vector<UserId> watchers;
+  };
+
+  /// @brief Returns how many repositories a user can watch, grows with the GitHub tokens pool capacity
+  std::size_t maxWatchListRepositories() const;
+
   /// @brief Watch dog that retrieves new repositories data by the hour
   void watchDog();
+  /// @brief Fetches every repository of the watch list from GitHub
+  /// with up to m_watchdogMaxInFlightRequests requests in flight paced by GitApi's rate limiter,
+  /// then diffs and alerts the watchers as results arrive.
+  /// @returns earliest time one of the polled repositories is due again
+  std::time_t pollRepositories(std::vector<WatchedRepository>& watchList);
 
-  /// @brief Alerts user that his repository's stars have changed
-  void alertUserRepositoryStarsChange(UserId userId, const std::string& repositoryName, std::int64_t oldStarsCount, std::int64_t newStarsCount);
-  /// @brief Alerts user that his repository's watchers have changed
-  void alertUserRepositoryWatchersChange(UserId userId, const std::string& repositoryName, std::int64_t oldWatchersCount, std::int64_t newWatchersCount);
-  /// @brief Alerts user that his repository's issues have changed
-  void alertUserRepositoryIssuesChange(UserId userId, const std::string& repositoryName, std::int64_t oldIssuesCount, std::int64_t newIssuesCount);
-  /// @brief Alerts user that his repository's forks have changed
-  void alertUserRepositoryForksChange(UserId userId, const std::string& repositoryName, std::int64_t oldForksCount, std::int64_t newForksCount);
-  /// @brief Alerts user that his repository's pull requests have changed
-  void alertUserRepositoryPullRequestsChange(UserId userId, const std::string& repositoryName, std::int64_t oldPullsCount, std::int64_t newPullsCount);
+  /// @brief Changes of a repository in a cycle as a digest section, immutable so all of its watchers digests share it
+  using ChangesSection = std::shared_ptr<const std::string>;
+  /// @brief Compares the local repository snapshot against the freshly fetched remote one
+  /// and renders every counter that has changed into a section of the watchers digests, once no matter how many users watch it
+  /// @returns changes section, nullptr if no counter has changed
+  static ChangesSection renderRepositoryChanges(const models::Repository& localRepo, const models::Repository& remoteRepo);
+  /// @brief Computes when a repository should be polled next: its interval shrinks when it changed
+  /// and grows when it didn't, within [kMinPollInterval, kMaxPollInterval]. Sets repo's schedule fields, the caller saves them.
+  /// @returns when the repository is due again
+  std::time_t scheduleNextPoll(models::Repository& repo, bool changed);
+  /// @brief Appends repository's stars change lines to a digest section
+  static void appendStarsChange(std::ostream& oss, std::int64_t oldStarsCount, std::int64_t newStarsCount);
+  /// @brief Appends repository's watchers change lines to a digest section
+  static void appendWatchersChange(std::ostream& oss, std::int64_t oldWatchersCount, std::int64_t newWatchersCount);
+  /// @brief Appends repository's issues change lines to a digest section
+  static void appendIssuesChange(std::ostream& oss, std::int64_t oldIssuesCount, std::int64_t newIssuesCount);
+  /// @brief Appends repository's forks change lines to a digest section
+  static void appendForksChange(std::ostream& oss, std::int64_t oldForksCount, std::int64_t newForksCount);
+  /// @brief Appends repository's pull requests change lines to a digest section
+  static void appendPullRequestsChange(std::ostream& oss, std::int64_t oldPullsCount, std::int64_t newPullsCount);
 
 private:
   /// @brief Notify admin with a message.
@@ -69,7 +104,7 @@ private:
   void notifyAdmin(const std::string& msg, const std::source_location& loc = std::source_location::current());
 
 private:
-  /// @brief Sends a message asynchronously and safely by retrying up to 5 times on failure
+  /// @brief Sends a message asynchronously and safely through the outbound dispatcher, which paces it to Telegram rate limits and retries it on failure
   /// Primarily inspired by @OMRKiruha from Issue: https://github.com/baderouaich/tgbotxx/issues/4#issuecomment-2016816708
   void safeSendMessage(UserId userId, std::string messageText,
                        std::int32_t messageThreadId = 0,
@@ -85,6 +120,10 @@ private:
   /// @brief Sends a large message > 4096 (Telegram message limit) partially in chunks [Used by safeSendMessage]
   void safeSendLargeMessage(UserId userId, const std::string &messageText);
 
+public:
+  /// @brief Splits text into chunks of at most maxSize bytes, cut at line boundaries when possible and never inside a UTF-8 character
+  static std::vector<std::string_view> splitMessage(std::string_view text, std::size_t maxSize);
+
 public:
   /// @brief Returns true if str is a repository full name e.g "torvalds/linux"
   static bool isRepositoryFullName(const std::string &str);
@@ -94,13 +133,29 @@ public:
 
 private:
   UserId m_adminUserId{}; ///<! Telegram user id for Admin to be notified with critical issues
+  std::size_t m_watchdogMaxInFlightRequests{kDefaultWatchdogMaxInFlightRequests}; ///<! Maximum concurrent GitHub requests while the watchdog polls repositories
   std::unique_ptr<GitApi> m_gitApi; ///<! GitHub Api for getting repository information
   std::unique_ptr<std::thread> m_watchdogThread; ///<! Watch dog thread that retrieves repositories information and dispatches alerts
-  std::mutex m_sleepMutex; ///<! Mutex for watch dog sleep
+  std::mutex m_sleepMutex; ///<! Mutex for watch dog and long poll error sleeps
   std::atomic<bool> m_watchdogRunning; ///<! True if watch dog is currently running
   std::condition_variable m_watchdogCv; ///<! Watch dog conditional variable to be notified and awaken from sleep if Bot wants to exit immediately
-  std::unique_ptr<cpr::ThreadPool> m_threadPool; ///<! Thread pool to handle multiple user requests simultaneously
+  std::unique_ptr<Executor> m_executor; ///<! Work-stealing thread pool to handle multiple user requests simultaneously
+  std::unique_ptr<TelegramDispatcher> m_telegramDispatcher; ///<! Outbound messages queue, paced to Telegram rate limits
+  std::atomic<bool> m_stopping{false}; ///<! True once Bot is stopping
+  std::condition_variable m_longPollCv; ///<! Long poll error backoff conditional variable, notified when Bot is stopping to interrupt the backoff
+  std::size_t m_longPollErrors{}; ///<! Consecutive long poll errors [polling thread]
+  std::chrono::steady_clock::time_point m_lastLongPollErrorAt{}; ///<! [polling thread]
 
   inline static constexpr std::size_t kTelegramMessageMax = 4096; ///<! Telegram limits each message to 4096 characters max
-  inline static constexpr std::size_t kMaxWatchListRepositories = 25; ///<! For now 25 repos watch limit per user, to not exceed github api rate limits
+  inline static constexpr std::size_t kMaxWatchListRepositories = 25; ///<! Repos watch limit per user for an unauthenticated GitHub client, to not exceed github api rate limits
+  inline static constexpr std::size_t kMaxWatchListRepositoriesCap = 500; ///<! Repos watch limit per user no matter how many GitHub tokens we have
+  inline static constexpr std::chrono::seconds kDefaultPollInterval = std::chrono::hours(1); ///<! Polling interval of newly added repositories
+  inline static constexpr std::chrono::seconds kMinPollInterval = std::chrono::minutes(15); ///<! Most active repositories are polled this often
+  inline static constexpr std::chrono::seconds kMaxPollInterval = std::chrono::hours(24); ///<! Dormant repositories are still polled at least this often
+  inline static constexpr std::chrono::seconds kWatchdogMinSleep = std::chrono::minutes(1); ///<! Minimum watchdog nap between two cycles
+  inline static constexpr std::chrono::seconds kBackupInterval = std::chrono::hours(1); ///<! How often the watchdog backs up the database
+  inline static constexpr std::chrono::seconds kPullsCountRefreshInterval = std::chrono::hours(3); ///<! How often the watchdog refreshes pulls count over the strictly rate limited search Api (REST backend)
+  inline static constexpr Backoff kLongPollBackoff{std::chrono::seconds(1), std::chrono::minutes(1)}; ///<! Interruptible delay before long polling again after an error, the polling thread waits it out
+  inline static constexpr std::chrono::minutes kLongPollErrorsReset = std::chrono::minutes(5); ///<! Long poll errors are no longer consecutive after this long without any
+  inline static constexpr std::size_t kDefaultWatchdogMaxInFlightRequests = 8; ///<! Watchdog concurrent GitHub requests unless res/WATCHDOG_MAX_IN_FLIGHT_REQUESTS.txt says otherwise
 };
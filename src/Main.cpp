@@ -1,7 +1,22 @@
 #include "GitBot.hpp"
+#include "db/BackupChain.hpp"
 #include <csignal>
+#include <iostream>
+#include <string_view>
 
 int main(int argc, const char *argv[]) {
+  // Restore mode: GitWatcherBot --restore <output.db> [YYYY-MM-DD-HH-MM-SS]
+  if (argc >= 3 and std::string_view(argv[1]) == "--restore") {
+    try {
+      const std::string restoredTime = BackupChain::restore(fs::path(RES_DIR) / "DbBackups", argv[2], argc >= 4 ? argv[3] : "9999");
+      std::cout << "Restored database as of " << restoredTime << " into " << argv[2] << std::endl;
+      return EXIT_SUCCESS;
+    } catch (const std::exception &e) {
+      std::cerr << "Restore failed: " << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
   static std::unique_ptr<GitBot> BOT = std::make_unique<GitBot>();
   for (const int sig: {SIGINT, SIGABRT, SIGKILL, SIGTERM, SIGSEGV, SIGHUP}) {
     std::signal(sig, [](int s) { // Graceful Bot exit on CTRL+C, Segmentation Fault, Abort, Console close (hangup)...
@@ -1,12 +1,40 @@
 #include "GitApi.hpp"
 
+GitApi::GitApi() : m_tokenPool(fs::path(RES_DIR) / "GITHUB_TOKENS.txt") {
+}
+
 models::Repository GitApi::getRepository(const std::string &repositoryFullName) {
-  cpr::Session session{};
-  session.SetUrl("https://api.github.com/repos/" + repositoryFullName);
-  session.SetConnectTimeout(cpr::ConnectTimeout{std::chrono::milliseconds(20'000)});
-  session.SetTimeout(cpr::Timeout{std::chrono::seconds(60)});
+  models::Repository repo = getRepository(repositoryFullName, m_tokenPool.pick());
+  repo.pulls_count = getPullsCount(repo.full_name, m_tokenPool.pick(&GitToken::searchRateLimiter));
+  repo.pullsUpdatedAt = std::time(nullptr);
+  return repo;
+}
+
+models::Repository GitApi::getRepository(const std::string &repositoryFullName, GitToken &token) {
+  return *fetchRepository(repositoryFullName, cpr::Header{}, token);
+}
+
+std::optional<models::Repository> GitApi::getRepositoryIfModified(const models::Repository &cachedRepo, GitToken &token) {
+  cpr::Header headers{};
+  if (not cachedRepo.etag.empty()) headers["If-None-Match"] = cachedRepo.etag;
+  if (not cachedRepo.last_modified.empty()) headers["If-Modified-Since"] = cachedRepo.last_modified;
+  return fetchRepository(cachedRepo.full_name, std::move(headers), token);
+}
+
+std::optional<models::Repository> GitApi::fetchRepository(const std::string &repositoryFullName, cpr::Header headers, GitToken &token) {
+  if (not token.value.empty()) headers["Authorization"] = "Bearer " + token.value;
 
-  cpr::Response res = session.Get();
+  SessionPool::Lease session = m_sessions.acquire();
+  session->SetUrl("https://api.github.com/repos/" + repositoryFullName);
+  session->SetHeader(headers);
+  session->SetConnectTimeout(cpr::ConnectTimeout{kConnectTimeout});
+  session->SetTimeout(cpr::Timeout{kTimeout});
+
+  cpr::Response res = session->Get();
+  updateRateLimit(res, token.rateLimiter);
+  if (res.status_code == 304) { // Not Modified, nothing to parse
+    return std::nullopt;
+  }
   nl::json json{};
   try {
     json = nl::json::parse(res.text);
@@ -24,5 +52,154 @@ models::Repository GitApi::getRepository(const std::string &repositoryFullName)
       throw std::runtime_error("Failed to get Repository '" + repositoryFullName + "': " + json["message"].get<std::string>());
     }
   }
-  return models::Repository(json);
+  models::Repository repo(json);
+  if (auto it = res.header.find("ETag"); it != res.header.end()) repo.etag = it->second;
+  if (auto it = res.header.find("Last-Modified"); it != res.header.end()) repo.last_modified = it->second;
+  return repo;
+}
+
+std::int64_t GitApi::getPullsCount(const std::string &repositoryFullName, GitToken &token) {
+  // for pulls its different https://stackoverflow.com/questions/40534533/count-open-pull-requests-and-issues-on-github
+  // https://api.github.com/search/issues?q=repo:baderouaich/tgbotxx%20is:pr%20is:open&per_page=1
+  SessionPool::Lease session = m_sessions.acquire();
+  session->SetUrl("https://api.github.com/search/issues?q=repo:" + repositoryFullName + "%20is:pr%20is:open&per_page=1");
+  session->SetHeader(token.value.empty() ? cpr::Header{} : cpr::Header{{"Authorization", "Bearer " + token.value}});
+  session->SetConnectTimeout(cpr::ConnectTimeout{kSearchConnectTimeout});
+  session->SetTimeout(cpr::Timeout{kSearchTimeout});
+
+  cpr::Response res = session->Get();
+  updateRateLimit(res, token.searchRateLimiter);
+  nl::json json{};
+  try {
+    json = nl::json::parse(res.text);
+  } catch (const std::exception &e) {
+    LOGE2("Github search Api json parsing error: " << e.what(), res.text);
+    throw std::runtime_error("Failed to get pulls count of '" + repositoryFullName + "'. Please try again later.");
+  }
+  if (json.contains("message")) {
+    std::string msg = json["message"];
+    if (tgbotxx::StringUtils::toLowerCopy(msg).contains("rate limit exceeded")) {
+      throw GitApiRateLimitExceededException(msg);
+    }
+    throw std::runtime_error("Failed to get pulls count of '" + repositoryFullName + "': " + msg);
+  }
+  try {
+    return json["total_count"].get<std::int64_t>();
+  } catch (const std::exception &e) {
+    throw std::runtime_error("Failed to get pulls_count for " + repositoryFullName + ": " + e.what());
+  }
+}
+
+std::vector<std::optional<models::Repository>> GitApi::getRepositories(const std::vector<std::string> &repositoriesFullNames, GitToken &token) {
+  if (token.value.empty()) {
+    throw std::runtime_error("GitHub GraphQL Api requires an access token, add one to res/GITHUB_TOKENS.txt");
+  }
+  if (repositoriesFullNames.size() > kGraphQLBatchSize) {
+    throw std::invalid_argument("Can't fetch more than " + std::to_string(kGraphQLBatchSize) + " repositories per GraphQL query");
+  }
+
+  // query($o0: String!, $n0: String!, ...) { r0: repository(owner: $o0, name: $n0) { ...Counters } ... }
+  // Names are passed as variables so they don't need escaping.
+  std::ostringstream params{}, fields{};
+  nl::json variables = nl::json::object();
+  for (std::size_t i = 0; i < repositoriesFullNames.size(); ++i) {
+    const std::string &fullName = repositoriesFullNames[i];
+    const std::size_t slash = fullName.find('/');
+    variables["o" + std::to_string(i)] = fullName.substr(0, slash);
+    variables["n" + std::to_string(i)] = slash == std::string::npos ? "" : fullName.substr(slash + 1);
+    params << (i ? ", " : "") << "$o" << i << ": String!, $n" << i << ": String!";
+    fields << " r" << i << ": repository(owner: $o" << i << ", name: $n" << i << ") { ...Counters }";
+  }
+  const std::string query = "query(" + params.str() + ") {" + fields.str() + " }"
+                            " fragment Counters on Repository {"
+                            " databaseId nameWithOwner description stargazerCount forkCount diskUsage"
+                            " primaryLanguage { name }"
+                            " issues(states: OPEN) { totalCount }"
+                            " pullRequests(states: OPEN) { totalCount } }";
+  const nl::json body = {{"query", query}, {"variables", variables}};
+
+  SessionPool::Lease session = m_graphqlSessions.acquire();
+  session->SetUrl("https://api.github.com/graphql");
+  session->SetHeader(cpr::Header{{"Authorization", "Bearer " + token.value}, {"Content-Type", "application/json"}});
+  session->SetBody(cpr::Body{body.dump()});
+  session->SetConnectTimeout(cpr::ConnectTimeout{kConnectTimeout});
+  session->SetTimeout(cpr::Timeout{kTimeout});
+
+  cpr::Response res = session->Post();
+  updateRateLimit(res, token.graphqlRateLimiter);
+  nl::json json{};
+  try {
+    json = nl::json::parse(res.text);
+  } catch (const std::exception &e) {
+    LOGE2("Github GraphQL Api json parsing error: " << e.what(), res.text);
+    throw std::runtime_error("Failed to get " + std::to_string(repositoriesFullNames.size()) + " Repositories. Please try again later.");
+  }
+  if (json.contains("message")) { // Not a GraphQL reply, e.g Bad credentials or primary rate limit exceeded
+    std::string msg = json["message"];
+    if (tgbotxx::StringUtils::toLowerCopy(msg).contains("rate limit")) {
+      throw GitApiRateLimitExceededException(msg);
+    }
+    throw std::runtime_error("Failed to get Repositories: " + msg);
+  }
+  if (json.contains("errors")) {
+    for (const nl::json &error: json["errors"]) {
+      const std::string type = error.value("type", "");
+      if (type == "RATE_LIMITED") {
+        throw GitApiRateLimitExceededException(error.value("message", "GraphQL rate limit exceeded"));
+      }
+      if (type != "NOT_FOUND") { // missing repositories just come back as null
+        LOGW2("Github GraphQL Api error: " << error.value("message", ""), error.dump());
+      }
+    }
+  }
+  if (not json.contains("data") or json["data"].is_null()) {
+    throw std::runtime_error("Failed to get Repositories: GraphQL reply has no data");
+  }
+
+  std::vector<std::optional<models::Repository>> repositories(repositoriesFullNames.size());
+  const nl::json &data = json["data"];
+  for (std::size_t i = 0; i < repositoriesFullNames.size(); ++i) {
+    const std::string alias = "r" + std::to_string(i);
+    if (not data.contains(alias) or data[alias].is_null()) continue;
+    const nl::json &r = data[alias];
+
+    models::Repository &repo = repositories[i].emplace();
+    repo.id = r["databaseId"];
+    repo.full_name = r["nameWithOwner"];
+    repo.stargazers_count = r["stargazerCount"];
+    repo.watchers_count = repo.stargazers_count; // REST's watchers_count is an alias of stargazers_count
+    repo.pulls_count = r["pullRequests"]["totalCount"];
+    repo.pullsUpdatedAt = std::time(nullptr);
+    repo.open_issues_count = r["issues"]["totalCount"].get<std::int64_t>() + repo.pulls_count; // REST's open_issues_count counts pull requests too
+    repo.forks_count = r["forkCount"];
+    repo.description = r["description"].is_string() ? r["description"].get<std::string>() : "";
+    repo.size = r["diskUsage"].is_number() ? r["diskUsage"].get<std::size_t>() : 0;
+    repo.language = r["primaryLanguage"].is_object() ? r["primaryLanguage"]["name"].get<std::string>() : "";
+    repo.createdAt = std::time(nullptr);
+    repo.updatedAt = repo.createdAt;
+  }
+  return repositories;
+}
+
+void GitApi::updateRateLimit(const cpr::Response &res, RateLimiter &rateLimiter) {
+  auto headerValue = [&res](const std::string &name) -> std::optional<std::int64_t> {
+    if (auto it = res.header.find(name); it != res.header.end()) {
+      try {
+        return std::stoll(it->second);
+      } catch (const std::exception &) {
+      }
+    }
+    return std::nullopt;
+  };
+
+  const auto limit = headerValue("X-RateLimit-Limit");
+  const auto remaining = headerValue("X-RateLimit-Remaining");
+  const auto reset = headerValue("X-RateLimit-Reset");
+  if (limit && remaining && reset) {
+    rateLimiter.update(*limit, *remaining, static_cast<std::time_t>(*reset));
+  }
+  // Secondary rate limits tell us how many seconds to wait before retrying
+  if (const auto retryAfter = headerValue("Retry-After")) {
+    rateLimiter.blockUntil(std::time(nullptr) + *retryAfter);
+  }
 }
\ No newline at end of file
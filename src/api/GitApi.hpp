@@ -8,7 +8,9 @@
 #include <nlohmann/json.hpp>
 #include <cpr/cpr.h>
 #include "db/Database.hpp"
-#include "log/Logger.hpp" ///<! must include Database with Logger for models::Log & Database::addLog
+#include "api/SessionPool.hpp"
+#include "api/TokenPool.hpp"
+#include "log/Logger.hpp" ///<! must include Database with Logger for models::Log & LogWriter
 namespace nl = nlohmann;
 
 /// @ref https://docs.github.com/en/rest/using-the-rest-api/troubleshooting-the-rest-api?apiVersion=2022-11-28#rate-limit-errors
@@ -25,10 +27,61 @@ struct GitApiRepositoryNotFoundException : std::runtime_error {
 
 class GitApi {
 public:
-  GitApi() = default;
+  /// @brief Loads GitHub access tokens from res/GITHUB_TOKENS.txt if any
+  GitApi();
   ~GitApi() = default;
 
-  /// @brief Returns Repository information by fullname from GitHub Api
+  /// @brief Returns Repository information by fullname from GitHub Api, including its open pull requests count
   models::Repository getRepository(const std::string& repositoryFullName = "torvalds/linux");
+  /// @brief Returns Repository information by fullname from GitHub Api, sent with given token.
+  /// @note pulls_count is left to 0, fetch it with getPullsCount()
+  models::Repository getRepository(const std::string& repositoryFullName, GitToken& token);
+
+  /// @brief Returns the count of open pull requests of a repository using the search Api.
+  /// The search Api has its own, much stricter, rate limit so the request is charged against token's search budget.
+  /// @ref https://docs.github.com/en/rest/search/search?apiVersion=2022-11-28#rate-limit
+  std::int64_t getPullsCount(const std::string& repositoryFullName, GitToken& token);
+
+  /// @brief Returns Repository information only if it has changed since cachedRepo was fetched.
+  /// @note pulls_count is left to 0, fetch it with getPullsCount()
+  /// Sends a conditional request with cachedRepo's ETag (If-None-Match) and Last-Modified (If-Modified-Since).
+  /// A 304 saves downloading and parsing the repository, but GitHub only leaves 304s out of the rate limit of authenticated requests,
+  /// so without a token it costs a request of the budget like any other (and is charged against token's local budget all the same).
+  /// @returns std::nullopt if GitHub replied 304 Not Modified, meaning cachedRepo is still up to date
+  /// @ref https://docs.github.com/en/rest/using-the-rest-api/best-practices-for-using-the-rest-api#use-conditional-requests-if-appropriate
+  std::optional<models::Repository> getRepositoryIfModified(const models::Repository& cachedRepo, GitToken& token);
+
+  /// @brief Returns information of up to kGraphQLBatchSize repositories in a single aliased GraphQL query,
+  /// filling the same Repository fields the REST Api fills, except the etag and last_modified validators (GraphQL has no conditional requests).
+  /// @param repositoriesFullNames repositories full names (example: "torvalds/linux")
+  /// @param token access token to send the query with, charged against its GraphQL budget (GraphQL Api requires authentication)
+  /// @returns Repositories in the same order as repositoriesFullNames, std::nullopt for repositories that were not found
+  /// @ref https://docs.github.com/en/graphql/reference/objects#repository
+  std::vector<std::optional<models::Repository>> getRepositories(const std::vector<std::string>& repositoriesFullNames, GitToken& token);
+
+  /// @brief Returns the GitHub access tokens pool, each token's budget is kept in sync with the X-RateLimit-* headers of responses.
+  /// Call acquire() on it before sending a background request (e.g watchdog polling) to spread requests over the rate limit window.
+  [[nodiscard]] TokenPool& tokenPool() noexcept { return m_tokenPool; }
+
+private:
+  /// @brief Feeds X-RateLimit-Limit, X-RateLimit-Remaining, X-RateLimit-Reset and Retry-After response headers to the rate limiter
+  static void updateRateLimit(const cpr::Response& res, RateLimiter& rateLimiter);
+
+  /// @brief Sends GET /repos/{repositoryFullName} with extra request headers
+  /// @returns std::nullopt on 304 Not Modified
+  std::optional<models::Repository> fetchRepository(const std::string& repositoryFullName, cpr::Header headers, GitToken& token);
+
+public:
+  inline static constexpr std::chrono::seconds kConnectTimeout{20}; ///<! Connect timeout of core and GraphQL Api requests
+  inline static constexpr std::chrono::seconds kTimeout{60}; ///<! Timeout of core and GraphQL Api requests
+  inline static constexpr std::chrono::seconds kSearchConnectTimeout{10}; ///<! Connect timeout of search Api requests
+  inline static constexpr std::chrono::seconds kSearchTimeout{20}; ///<! Timeout of search Api requests, cheap queries that shouldn't hold a fetcher for long
+  inline static constexpr std::size_t kMaxIdleSessions = 16; ///<! Kept alive connections to api.github.com, enough for the watchdog fetchers plus a few commands
+  inline static constexpr std::size_t kGraphQLBatchSize = 100; ///<! Repositories fetched per GraphQL query (GitHub caps a connection at 100 nodes)
+
+private:
+  TokenPool m_tokenPool; ///<! GitHub access tokens and their core Api rate limit budgets
+  SessionPool m_sessions{kMaxIdleSessions}; ///<! Long lived sessions shared by all threads sending GitHub GET requests
+  SessionPool m_graphqlSessions{kMaxIdleSessions}; ///<! Sessions of GraphQL POST requests, cpr keeps a session's body once set so they can't serve GET requests
 
 };
@@ -0,0 +1,121 @@
+#include "RateLimiter.hpp"
+#include <algorithm>
+
+RateLimiter::RateLimiter(std::int64_t limit, std::chrono::seconds window)
+    : m_window(window),
+      m_limit(limit),
+      m_remaining(limit),
+      m_reset(std::time(nullptr) + window.count()),
+      m_tokens(std::max(1.0, static_cast<double>(limit) * kBurstRatio)),
+      m_lastRefill(Clock::now()) {
+}
+
+bool RateLimiter::acquire() {
+  std::unique_lock lock{m_mutex};
+  while (not m_stopped) {
+    refill(Clock::now());
+    if (take()) return true;
+    m_cv.wait_for(lock, nextTokenIn());
+  }
+  return false;
+}
+
+bool RateLimiter::tryAcquire() {
+  std::lock_guard guard{m_mutex};
+  if (m_stopped) return false;
+  refill(Clock::now());
+  return take();
+}
+
+RateLimiter::Clock::duration RateLimiter::timeUntilNextToken() {
+  std::lock_guard guard{m_mutex};
+  refill(Clock::now());
+  return nextTokenIn();
+}
+
+void RateLimiter::update(std::int64_t limit, std::int64_t remaining, std::time_t reset) {
+  std::lock_guard guard{m_mutex};
+  if (m_synced and reset < m_reset) return; // stale response from a previous window
+  m_limit = limit;
+  // Responses arrive out of order when requests are in flight concurrently, so within the same window keep the lowest remaining.
+  m_remaining = (m_synced and reset == m_reset) ? std::min(m_remaining, remaining) : remaining;
+  m_reset = reset;
+  m_synced = true;
+  m_cv.notify_all();
+}
+
+void RateLimiter::blockUntil(std::time_t until) {
+  std::lock_guard guard{m_mutex};
+  m_blockedUntil = std::max(m_blockedUntil, until);
+  m_tokens = 0.0; // don't burst right after the block
+}
+
+void RateLimiter::limitExceeded() {
+  std::lock_guard guard{m_mutex};
+  if (m_remaining > 0) {
+    m_blockedUntil = std::max(m_blockedUntil, std::time(nullptr) + static_cast<std::time_t>(kSecondaryLimitWait.count()));
+  }
+  m_tokens = 0.0;
+}
+
+void RateLimiter::stop() {
+  {
+    std::lock_guard guard{m_mutex};
+    m_stopped = true;
+  }
+  m_cv.notify_all();
+}
+
+std::int64_t RateLimiter::limit() const {
+  std::lock_guard guard{m_mutex};
+  return m_limit;
+}
+
+std::int64_t RateLimiter::remaining() const {
+  std::lock_guard guard{m_mutex};
+  return m_remaining;
+}
+
+std::time_t RateLimiter::resetAt() const {
+  std::lock_guard guard{m_mutex};
+  return m_reset;
+}
+
+void RateLimiter::refill(Clock::time_point now) {
+  const std::time_t epochNow = std::time(nullptr);
+  if (epochNow >= m_reset) { // window has reset, until GitHub tells us otherwise assume the full limit is back
+    m_remaining = m_limit;
+    m_reset = epochNow + m_window.count();
+    m_synced = false;
+  }
+
+  // Spread what's left of the budget evenly over what's left of the window
+  const double secondsToReset = static_cast<double>(std::max<std::time_t>(1, m_reset - epochNow));
+  m_ratePerSecond = static_cast<double>(m_remaining) / secondsToReset;
+
+  const double capacity = std::max(1.0, static_cast<double>(m_limit) * kBurstRatio);
+  const double elapsed = std::chrono::duration<double>(now - m_lastRefill).count();
+  m_tokens = std::min(capacity, m_tokens + elapsed * m_ratePerSecond);
+  m_lastRefill = now;
+}
+
+bool RateLimiter::take() {
+  if (std::time(nullptr) < m_blockedUntil) return false;
+  if (m_tokens >= 1.0 and m_remaining > 0) {
+    m_tokens -= 1.0;
+    --m_remaining;
+    return true;
+  }
+  return false;
+}
+
+RateLimiter::Clock::duration RateLimiter::nextTokenIn() const {
+  if (const std::time_t epochNow = std::time(nullptr); epochNow < m_blockedUntil) {
+    return std::chrono::seconds(m_blockedUntil - epochNow);
+  }
+  if (m_tokens >= 1.0 and m_remaining > 0) return Clock::duration::zero();
+  if (m_remaining <= 0 or m_ratePerSecond <= 0.0) {
+    return std::chrono::seconds(std::max<std::time_t>(1, m_reset - std::time(nullptr)));
+  }
+  return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>((1.0 - m_tokens) / m_ratePerSecond));
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+
+/// @brief Token bucket that spreads GitHub Api requests evenly over the rate limit window.
+/// Refill rate is `remaining / seconds until reset` and gets re-tuned from the X-RateLimit-Remaining and
+/// X-RateLimit-Reset headers of every GitHub response, so the budget lasts until the window resets instead of
+/// being burned at the beginning of the window and hitting GitApiRateLimitExceededException.
+/// @ref https://docs.github.com/en/rest/using-the-rest-api/rate-limits-for-the-rest-api#checking-the-status-of-your-rate-limit
+class RateLimiter {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /// @param limit requests allowed per window before GitHub tells us otherwise (60 an hour for unauthenticated requests)
+  /// @param window rate limit window duration
+  explicit RateLimiter(std::int64_t limit = 60, std::chrono::seconds window = std::chrono::hours(1));
+
+  /// @brief Blocks until a request may be sent and takes a token.
+  /// @returns false if the limiter was stopped while waiting
+  bool acquire();
+
+  /// @brief Takes a token if one is available right now, without waiting.
+  bool tryAcquire();
+
+  /// @brief Returns how long until the next token becomes available (zero if one is available now)
+  [[nodiscard]] Clock::duration timeUntilNextToken();
+
+  /// @brief Re-tunes the bucket with the rate limit status GitHub reported in a response headers
+  /// @param limit X-RateLimit-Limit
+  /// @param remaining X-RateLimit-Remaining
+  /// @param reset X-RateLimit-Reset, epoch seconds when the window resets
+  void update(std::int64_t limit, std::int64_t remaining, std::time_t reset);
+
+  /// @brief Blocks all requests until the given epoch time (Retry-After), budget and window are left to update()
+  void blockUntil(std::time_t until);
+
+  /// @brief Handles a rate limit exceeded reply: if the budget is spent requests already wait for the window to reset,
+  /// otherwise it was a secondary rate limit and requests are blocked for kSecondaryLimitWait.
+  /// @ref https://docs.github.com/en/rest/using-the-rest-api/rate-limits-for-the-rest-api#exceeding-the-rate-limit
+  void limitExceeded();
+
+  /// @brief Wakes up and rejects all current and future acquire() calls
+  void stop();
+
+  [[nodiscard]] std::int64_t limit() const;
+  [[nodiscard]] std::int64_t remaining() const;
+  [[nodiscard]] std::time_t resetAt() const;
+
+private:
+  /// @brief Recomputes refill rate and adds tokens earned since last refill. Must hold m_mutex.
+  void refill(Clock::time_point now);
+  /// @brief Takes a token if available. Must hold m_mutex and refill() first.
+  bool take();
+  /// @brief Time until the next token, until the window resets if the budget is spent, or until unblocked. Must hold m_mutex and refill() first.
+  [[nodiscard]] Clock::duration nextTokenIn() const;
+
+private:
+  mutable std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::chrono::seconds m_window;
+  std::int64_t m_limit; ///<! X-RateLimit-Limit
+  std::int64_t m_remaining; ///<! X-RateLimit-Remaining minus tokens we handed out since
+  std::time_t m_reset; ///<! X-RateLimit-Reset
+  bool m_synced{false}; ///<! True once m_reset comes from GitHub rather than our own guess
+  double m_tokens; ///<! Tokens currently in the bucket
+  double m_ratePerSecond{}; ///<! Tokens added per second
+  Clock::time_point m_lastRefill;
+  std::time_t m_blockedUntil{}; ///<! No request is sent before this epoch time (secondary rate limits)
+  bool m_stopped{false};
+
+  inline static constexpr std::chrono::seconds kSecondaryLimitWait = std::chrono::minutes(1); ///<! GitHub asks to wait at least a minute after a secondary rate limit without Retry-After
+  inline static constexpr double kBurstRatio = 0.1; ///<! Bucket capacity as a ratio of the limit, allows short bursts of requests
+};
@@ -0,0 +1,50 @@
+#include "SessionPool.hpp"
+
+SessionPool::SessionPool(std::size_t maxIdleSessions) : m_maxIdleSessions(maxIdleSessions) {
+  m_share = curl_share_init();
+  if (m_share) {
+    curl_share_setopt(m_share, CURLSHOPT_LOCKFUNC, &SessionPool::lockShare);
+    curl_share_setopt(m_share, CURLSHOPT_UNLOCKFUNC, &SessionPool::unlockShare);
+    curl_share_setopt(m_share, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+  }
+}
+
+SessionPool::~SessionPool() {
+  m_idle.clear(); // sessions must be closed before the share handle they use
+  if (m_share) curl_share_cleanup(m_share);
+}
+
+SessionPool::Lease SessionPool::acquire() {
+  {
+    std::lock_guard guard{m_mutex};
+    if (not m_idle.empty()) {
+      std::unique_ptr<cpr::Session> session = std::move(m_idle.back());
+      m_idle.pop_back();
+      return Lease(*this, std::move(session));
+    }
+  }
+
+  auto session = std::make_unique<cpr::Session>();
+  session->SetHttpVersion(cpr::HttpVersion{cpr::HttpVersionCode::VERSION_2_0_TLS}); // falls back to HTTP/1.1 if curl or server can't
+  CURL *handle = session->GetCurlHolder()->handle;
+  curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+  if (m_share) curl_easy_setopt(handle, CURLOPT_SHARE, m_share);
+  return Lease(*this, std::move(session));
+}
+
+void SessionPool::release(std::unique_ptr<cpr::Session> session) {
+  std::lock_guard guard{m_mutex};
+  if (m_idle.size() < m_maxIdleSessions) {
+    m_idle.push_back(std::move(session));
+  }
+}
+
+void SessionPool::lockShare([[maybe_unused]] CURL *handle, curl_lock_data data, [[maybe_unused]] curl_lock_access access, void *userptr) {
+  static_cast<SessionPool *>(userptr)->m_shareMutexes[data].lock();
+}
+
+void SessionPool::unlockShare([[maybe_unused]] CURL *handle, curl_lock_data data, void *userptr) {
+  static_cast<SessionPool *>(userptr)->m_shareMutexes[data].unlock();
+}
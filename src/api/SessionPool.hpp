@@ -0,0 +1,60 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cpr/cpr.h>
+#include <curl/curl.h>
+
+/// @brief Pool of long lived cpr::Session objects shared across the watchdog and command threads.
+/// A cpr::Session wraps a curl easy handle which keeps its connection to api.github.com alive between requests,
+/// so reusing sessions saves a TCP + TLS handshake per request. New sessions negotiate HTTP/2 when curl supports it,
+/// and all sessions share a curl DNS cache and TLS session cache so even a freshly created session resumes TLS.
+class SessionPool {
+public:
+  /// @brief Session borrowed from the pool, returned to the pool when destroyed
+  class Lease {
+  public:
+    Lease(SessionPool &pool, std::unique_ptr<cpr::Session> session) noexcept : m_pool(&pool), m_session(std::move(session)) {}
+    Lease(Lease &&) noexcept = default;
+    Lease &operator=(Lease &&) noexcept = delete;
+    Lease(const Lease &) = delete;
+    Lease &operator=(const Lease &) = delete;
+    ~Lease() {
+      if (m_session) m_pool->release(std::move(m_session));
+    }
+
+    cpr::Session *operator->() const noexcept { return m_session.get(); }
+    cpr::Session &operator*() const noexcept { return *m_session; }
+
+  private:
+    SessionPool *m_pool;
+    std::unique_ptr<cpr::Session> m_session;
+  };
+
+public:
+  /// @param maxIdleSessions maximum sessions kept alive in the pool when not in use, extra sessions are closed on release
+  explicit SessionPool(std::size_t maxIdleSessions);
+  ~SessionPool();
+  SessionPool(const SessionPool &) = delete;
+  SessionPool &operator=(const SessionPool &) = delete;
+
+  /// @brief Borrows an idle session or creates a new one if all sessions are in use.
+  /// @note The session keeps settings of its previous request, set url, headers, body and timeouts before sending.
+  /// A body is never cleared once set (a later Get() still sends it), so don't share a pool between GET and POST requests.
+  [[nodiscard]] Lease acquire();
+
+private:
+  void release(std::unique_ptr<cpr::Session> session);
+
+  static void lockShare(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr);
+  static void unlockShare(CURL *handle, curl_lock_data data, void *userptr);
+
+private:
+  std::mutex m_mutex;
+  std::vector<std::unique_ptr<cpr::Session>> m_idle;
+  std::size_t m_maxIdleSessions;
+  CURLSH *m_share{nullptr}; ///<! DNS and TLS session caches shared by all sessions
+  std::array<std::mutex, CURL_LOCK_DATA_LAST> m_shareMutexes;
+};
@@ -0,0 +1,138 @@
+#include "TelegramDispatcher.hpp"
+#include <algorithm>
+#include <charconv>
+#include <exception>
+#include <string>
+#include "log/Logger.hpp"
+
+TelegramDispatcher::TelegramDispatcher(std::size_t senders)
+    : m_tokens(kGlobalBurst),
+      m_lastRefill(Clock::now()) {
+  m_senders.reserve(senders);
+  for (std::size_t i = 0; i < senders; ++i) {
+    m_senders.emplace_back(&TelegramDispatcher::run, this);
+  }
+}
+
+TelegramDispatcher::~TelegramDispatcher() {
+  if (not m_senders.empty()) stop(std::chrono::seconds(0));
+}
+
+void TelegramDispatcher::send(ChatId chatId, std::function<void()> request) {
+  {
+    std::lock_guard guard{m_mutex};
+    if (m_stopped) {
+      LOGW("Telegram dispatcher is stopped, dropping message to chat " << chatId);
+      return;
+    }
+    if (m_chats.size() > kMaxIdleChats) {
+      const Clock::time_point now = Clock::now();
+      std::erase_if(m_chats, [now](const auto &entry) { return not entry.second.scheduled and entry.second.readyAt <= now; });
+    }
+    Chat &chat = m_chats[chatId];
+    chat.requests.push_back(Request{.send = std::move(request)});
+    ++m_queued;
+    if (not chat.scheduled) {
+      chat.scheduled = true;
+      m_ready.emplace(chat.readyAt, chatId);
+    }
+  }
+  m_cv.notify_one();
+}
+
+std::size_t TelegramDispatcher::queueDepth() const {
+  std::lock_guard guard{m_mutex};
+  return m_queued;
+}
+
+void TelegramDispatcher::stop(std::chrono::seconds drainTimeout) {
+  {
+    std::unique_lock lock{m_mutex};
+    m_drained.wait_for(lock, drainTimeout, [this] { return m_queued == 0 and m_inFlight == 0; });
+    m_stopped = true;
+    if (m_queued) {
+      LOGW("Telegram dispatcher stopped with " << m_queued << " unsent messages");
+    }
+  }
+  m_cv.notify_all();
+  m_senders.clear(); // join
+}
+
+std::optional<std::chrono::seconds> TelegramDispatcher::retryAfter(std::string_view error) {
+  static constexpr std::string_view kRetryAfter = "retry after ";
+  const std::size_t pos = error.find(kRetryAfter);
+  if (pos == std::string_view::npos) return std::nullopt;
+  const std::string_view value = error.substr(pos + kRetryAfter.size());
+  std::int64_t seconds{};
+  if (std::from_chars(value.data(), value.data() + value.size(), seconds).ec != std::errc{}) return std::nullopt;
+  return std::chrono::seconds(std::max<std::int64_t>(seconds, 1));
+}
+
+void TelegramDispatcher::refill(Clock::time_point now) {
+  const double elapsed = std::chrono::duration<double>(now - m_lastRefill).count();
+  m_tokens = std::min(kGlobalBurst, m_tokens + elapsed * kGlobalRate);
+  m_lastRefill = now;
+}
+
+void TelegramDispatcher::run() {
+  std::unique_lock lock{m_mutex};
+  while (not m_stopped) {
+    if (m_ready.empty()) {
+      m_cv.wait(lock);
+      continue;
+    }
+    const auto [readyAt, chatId] = m_ready.top();
+    const Clock::time_point now = Clock::now();
+    refill(now);
+    const Clock::time_point tokenAt = m_tokens >= 1.0 ? now : now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>((1.0 - m_tokens) / kGlobalRate));
+    const Clock::time_point sendAt = std::max(readyAt, tokenAt);
+    if (sendAt > now) {
+      m_cv.wait_until(lock, sendAt);
+      continue;
+    }
+    m_ready.pop();
+    m_tokens -= 1.0;
+    Request request = std::move(m_chats[chatId].requests.front());
+    m_chats[chatId].requests.pop_front();
+    --m_queued;
+    ++m_inFlight;
+    lock.unlock();
+
+    std::optional<Clock::duration> retryIn{};
+    std::string error{};
+    try {
+      request.send();
+    } catch (const std::exception &e) {
+      error = e.what();
+    } catch (...) {
+      error = "unknown error";
+    }
+    if (not error.empty()) {
+      if (std::optional<std::chrono::seconds> after = retryAfter(error)) {
+        LOGW("Telegram flood control, pausing chat " << chatId << " for " << after->count() << "s");
+        retryIn = *after; // not the request's fault, doesn't count as an attempt
+      } else if (++request.attempt < kMaxAttempts) {
+        LOGE("Can't send message to chat " << chatId << " on attempt №" << request.attempt << ": " << error);
+        retryIn = kRetryBackoff.delay(request.attempt);
+      } else {
+        LOGE("Giving up sending message to chat " << chatId << " after " << request.attempt << " attempts: " << error);
+      }
+    }
+
+    lock.lock();
+    --m_inFlight;
+    Chat &chat = m_chats[chatId];
+    chat.readyAt = Clock::now() + (retryIn ? *retryIn : kChatInterval);
+    if (retryIn) {
+      chat.requests.push_front(std::move(request));
+      ++m_queued;
+    }
+    if (chat.requests.empty()) {
+      chat.scheduled = false;
+    } else {
+      m_ready.emplace(chat.readyAt, chatId);
+      m_cv.notify_one();
+    }
+    m_drained.notify_all();
+  }
+}
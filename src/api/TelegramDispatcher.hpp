@@ -0,0 +1,86 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "utils/Backoff.hpp"
+
+/// @brief Single outbound queue of Telegram requests, sent at the highest rate Telegram allows:
+/// 30 messages a second overall (token bucket) and one message every kChatInterval per chat.
+/// Each chat has its own FIFO queue, so messages of a chat arrive in order and a chat waiting for its turn never holds back others.
+/// A "Too Many Requests: retry after N" reply pauses the chat for N seconds and the message is sent again, other failures are retried up to kMaxAttempts times
+/// with a jittered exponential backoff. Retries wait in the queue like any other request, no thread sleeps on them.
+/// @ref https://core.telegram.org/bots/faq#my-bot-is-hitting-limits-how-do-i-avoid-this
+class TelegramDispatcher {
+public:
+  using Clock = std::chrono::steady_clock;
+  using ChatId = std::int64_t;
+
+  /// @param senders threads sending requests concurrently, a single request takes a round trip to Telegram
+  explicit TelegramDispatcher(std::size_t senders = kSenders);
+  ~TelegramDispatcher();
+
+  TelegramDispatcher(const TelegramDispatcher &) = delete;
+  TelegramDispatcher &operator=(const TelegramDispatcher &) = delete;
+
+  /// @brief Queues a request to chatId, request performs the Api call and throws on failure to have it retried
+  void send(ChatId chatId, std::function<void()> request);
+
+  /// @brief Returns count of queued requests, not sent yet
+  [[nodiscard]] std::size_t queueDepth() const;
+
+  /// @brief Waits up to drainTimeout for queued requests to be sent, then stops senders. Requests still queued are dropped.
+  void stop(std::chrono::seconds drainTimeout = kStopDrainTimeout);
+
+  /// @brief Returns N of a Telegram "Too Many Requests: retry after N" error, std::nullopt for other errors
+  static std::optional<std::chrono::seconds> retryAfter(std::string_view error);
+
+private:
+  struct Request {
+    std::function<void()> send;
+    std::size_t attempt{};
+  };
+
+  struct Chat {
+    std::deque<Request> requests{};
+    Clock::time_point readyAt{}; ///<! Chat's next request can't be sent before
+    bool scheduled{false}; ///<! Chat is in m_ready or one of its requests is being sent
+  };
+
+  /// @brief Sender thread, sends the request of whichever chat is ready first as soon as the global budget allows
+  void run();
+  /// @brief Adds global tokens earned since last refill. Must hold m_mutex.
+  void refill(Clock::time_point now);
+
+private:
+  mutable std::mutex m_mutex;
+  std::condition_variable m_cv; ///<! Notified on new requests, chats becoming ready and stop
+  std::condition_variable m_drained; ///<! Notified when a request completes
+  std::unordered_map<ChatId, Chat> m_chats;
+  std::priority_queue<std::pair<Clock::time_point, ChatId>, std::vector<std::pair<Clock::time_point, ChatId>>, std::greater<>> m_ready; ///<! Chats with queued requests by readyAt
+  std::size_t m_queued{}; ///<! Requests waiting in m_chats
+  std::size_t m_inFlight{}; ///<! Requests being sent
+  double m_tokens; ///<! Global token bucket
+  Clock::time_point m_lastRefill;
+  bool m_stopped{false};
+  std::vector<std::jthread> m_senders;
+
+  inline static constexpr double kGlobalRate = 29.0; ///<! Messages a second sent overall, Telegram allows about 30
+  inline static constexpr double kGlobalBurst = 1.0; ///<! Global bucket capacity, any second holds at most kGlobalBurst + kGlobalRate messages
+  inline static constexpr std::chrono::seconds kChatInterval = std::chrono::seconds(1); ///<! Telegram allows about one message a second per chat
+  inline static constexpr std::size_t kMaxAttempts = 5; ///<! Attempts of a request failing with other errors than Too Many Requests
+  inline static constexpr Backoff kRetryBackoff{std::chrono::seconds(2), std::chrono::seconds(30)}; ///<! Delay before retrying a failed request
+  inline static constexpr std::size_t kSenders = 4;
+  inline static constexpr std::size_t kMaxIdleChats = 10'000; ///<! Idle chats are forgotten past this many chats (their pacing has elapsed anyway)
+  inline static constexpr std::chrono::seconds kStopDrainTimeout = std::chrono::seconds(10);
+};
@@ -0,0 +1,85 @@
+#include "TokenPool.hpp"
+#include <algorithm>
+#include <fstream>
+
+TokenPool::TokenPool(const std::filesystem::path &tokensFile) {
+  if (std::ifstream ifs{tokensFile}) {
+    for (std::string line; std::getline(ifs, line);) {
+      // trim spaces and \r of files edited on Windows
+      line.erase(0, line.find_first_not_of(" \t\r"));
+      line.erase(line.find_last_not_of(" \t\r") + 1);
+      if (line.empty() || line.starts_with('#')) continue;
+      m_tokens.push_back(std::make_unique<GitToken>(line, kAuthenticatedRateLimit, kAuthenticatedSearchRateLimit));
+    }
+  }
+  m_authenticated = not m_tokens.empty();
+  if (not m_authenticated) {
+    m_tokens.push_back(std::make_unique<GitToken>("", kUnauthenticatedRateLimit, kUnauthenticatedSearchRateLimit));
+  }
+}
+
+GitToken &TokenPool::pick(GitTokenBudget budget) {
+  auto best = std::ranges::max_element(m_tokens, {}, [budget](const std::unique_ptr<GitToken> &token) {
+    return ((*token).*budget).remaining();
+  });
+  return **best;
+}
+
+GitToken *TokenPool::acquire(GitTokenBudget budget) {
+  std::unique_lock lock{m_mutex};
+  while (not m_stopped) {
+    RateLimiter::Clock::duration wait = RateLimiter::Clock::duration::max();
+    for (GitToken *token: byRemaining(budget)) {
+      if ((token->*budget).tryAcquire()) return token;
+      wait = std::min(wait, (token->*budget).timeUntilNextToken());
+    }
+    // Nobody has budget right now, wait for the earliest token to refill
+    m_cv.wait_for(lock, wait);
+  }
+  return nullptr;
+}
+
+GitToken *TokenPool::tryAcquire(GitTokenBudget budget) {
+  std::lock_guard guard{m_mutex};
+  if (m_stopped) return nullptr;
+  for (GitToken *token: byRemaining(budget)) {
+    if ((token->*budget).tryAcquire()) return token;
+  }
+  return nullptr;
+}
+
+std::vector<GitToken *> TokenPool::byRemaining(GitTokenBudget budget) const {
+  std::vector<GitToken *> tokens{};
+  tokens.reserve(m_tokens.size());
+  for (const std::unique_ptr<GitToken> &token: m_tokens)
+    tokens.push_back(token.get());
+  std::ranges::sort(tokens, std::greater{}, [budget](GitToken *token) { return (token->*budget).remaining(); });
+  return tokens;
+}
+
+void TokenPool::stop() {
+  {
+    std::lock_guard guard{m_mutex};
+    m_stopped = true;
+  }
+  m_cv.notify_all();
+  for (const std::unique_ptr<GitToken> &token: m_tokens) {
+    token->rateLimiter.stop();
+    token->graphqlRateLimiter.stop();
+    token->searchRateLimiter.stop();
+  }
+}
+
+std::int64_t TokenPool::capacity(GitTokenBudget budget) const {
+  std::int64_t total{};
+  for (const std::unique_ptr<GitToken> &token: m_tokens)
+    total += ((*token).*budget).limit();
+  return total;
+}
+
+std::int64_t TokenPool::remaining(GitTokenBudget budget) const {
+  std::int64_t total{};
+  for (const std::unique_ptr<GitToken> &token: m_tokens)
+    total += ((*token).*budget).remaining();
+  return total;
+}
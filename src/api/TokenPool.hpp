@@ -0,0 +1,74 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "api/RateLimiter.hpp"
+
+/// @brief GitHub access token with its own rate limit budget
+struct GitToken {
+  std::string value; ///<! Personal access token, empty for unauthenticated requests
+  RateLimiter rateLimiter; ///<! REST core Api budget of this token, kept in sync with the X-RateLimit-* headers of responses sent with it
+  RateLimiter graphqlRateLimiter; ///<! GraphQL Api budget (points) of this token, GraphQL is rate limited separately from REST
+  RateLimiter searchRateLimiter; ///<! Search Api budget of this token, much stricter than the core Api and counted per minute
+
+  GitToken(std::string value, std::int64_t limit, std::int64_t searchLimit)
+      : value(std::move(value)), rateLimiter(limit), graphqlRateLimiter(limit), searchRateLimiter(searchLimit, std::chrono::minutes(1)) {}
+};
+
+/// @brief Selects which of GitToken's budgets a request is charged against
+using GitTokenBudget = RateLimiter GitToken::*;
+
+/// @brief Pool of GitHub access tokens loaded from res/GITHUB_TOKENS.txt (one token per line, # for comments).
+/// Each request goes out with the token that has the most remaining quota, so polling capacity grows
+/// linearly with the number of tokens. Without any token, the pool falls back to unauthenticated requests.
+/// @ref https://docs.github.com/en/rest/using-the-rest-api/rate-limits-for-the-rest-api#primary-rate-limit-for-authenticated-users
+class TokenPool {
+public:
+  explicit TokenPool(const std::filesystem::path& tokensFile);
+
+  /// @brief Returns the token with the most remaining quota without waiting for budget (used for interactive requests)
+  [[nodiscard]] GitToken& pick(GitTokenBudget budget = &GitToken::rateLimiter);
+
+  /// @brief Blocks until a token has budget, takes a request from it and returns it (used for paced background requests).
+  /// Tokens are tried from most to least remaining quota.
+  /// @param budget which of the tokens budgets the request is charged against
+  /// @returns nullptr if the pool was stopped while waiting
+  [[nodiscard]] GitToken* acquire(GitTokenBudget budget = &GitToken::rateLimiter);
+
+  /// @brief Takes a request from the token with the most remaining quota that has budget right now, without waiting.
+  /// @returns nullptr if no token has budget right now
+  [[nodiscard]] GitToken* tryAcquire(GitTokenBudget budget = &GitToken::rateLimiter);
+
+  /// @brief Wakes up and rejects all current and future acquire() calls
+  void stop();
+
+  /// @brief Returns number of tokens in the pool (1 for the unauthenticated fallback)
+  [[nodiscard]] std::size_t size() const noexcept { return m_tokens.size(); }
+  /// @brief Returns true if requests are sent with access tokens
+  [[nodiscard]] bool authenticated() const noexcept { return m_authenticated; }
+  /// @brief Returns total poll capacity of the pool: sum of all tokens requests per hour
+  [[nodiscard]] std::int64_t capacity(GitTokenBudget budget = &GitToken::rateLimiter) const;
+  /// @brief Returns total remaining requests of all tokens in their current windows
+  [[nodiscard]] std::int64_t remaining(GitTokenBudget budget = &GitToken::rateLimiter) const;
+
+public:
+  inline static constexpr std::int64_t kUnauthenticatedRateLimit = 60; ///<! Requests an hour per IP without a token
+  inline static constexpr std::int64_t kAuthenticatedRateLimit = 5000; ///<! Requests an hour per personal access token
+  inline static constexpr std::int64_t kUnauthenticatedSearchRateLimit = 10; ///<! Search requests a minute per IP without a token
+  inline static constexpr std::int64_t kAuthenticatedSearchRateLimit = 30; ///<! Search requests a minute per personal access token
+
+private:
+  /// @brief Returns tokens sorted from most to least remaining quota of the given budget
+  [[nodiscard]] std::vector<GitToken*> byRemaining(GitTokenBudget budget) const;
+
+private:
+  std::vector<std::unique_ptr<GitToken>> m_tokens;
+  bool m_authenticated{false};
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  bool m_stopped{false};
+};
@@ -0,0 +1,242 @@
+#include "BackupChain.hpp"
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include "tgbotxx/utils/DateTimeUtils.hpp"
+
+namespace {
+  /// Delta layout, integers are 32 bit little endian:
+  /// magic | version | pageSize | pageCount | changedCount | imageDigest | previousTimeLength | previousTime | changedCount x (pageIndex | page)
+  struct DeltaHeader {
+    std::uint32_t version;
+    std::uint32_t pageSize;
+    std::uint32_t pageCount; ///<! Database size in pages once the delta is applied
+    std::uint32_t changedCount;
+    Sha256::Digest imageDigest; ///<! SHA-256 of the whole database once the delta is applied
+    std::string previousTime; ///<! Time of the backup the delta applies on top of
+  };
+
+  void append(std::string &out, std::uint32_t value) {
+    for (int shift = 0; shift < 32; shift += 8)
+      out += static_cast<char>((value >> shift) & 0xFF);
+  }
+
+  std::string_view consume(std::string_view &in, std::size_t size) {
+    if (in.size() < size) throw std::runtime_error("Truncated backup delta");
+    std::string_view bytes = in.substr(0, size);
+    in.remove_prefix(size);
+    return bytes;
+  }
+
+  std::uint32_t consumeUint32(std::string_view &in) {
+    const std::string_view bytes = consume(in, sizeof(std::uint32_t));
+    std::uint32_t value = 0;
+    for (std::size_t i = bytes.size(); i-- > 0;)
+      value = (value << 8) | static_cast<unsigned char>(bytes[i]);
+    return value;
+  }
+
+  std::string encode(std::string_view magic, const DeltaHeader &header) {
+    std::string out{magic};
+    append(out, header.version);
+    append(out, header.pageSize);
+    append(out, header.pageCount);
+    append(out, header.changedCount);
+    out.append(reinterpret_cast<const char *>(header.imageDigest.data()), header.imageDigest.size());
+    append(out, static_cast<std::uint32_t>(header.previousTime.size()));
+    out += header.previousTime;
+    return out;
+  }
+
+  DeltaHeader decode(std::string_view magic, std::string_view &in) {
+    if (consume(in, magic.size()) != magic) {
+      throw std::runtime_error("Not a backup delta");
+    }
+    DeltaHeader header{};
+    header.version = consumeUint32(in);
+    header.pageSize = consumeUint32(in);
+    header.pageCount = consumeUint32(in);
+    header.changedCount = consumeUint32(in);
+    std::ranges::copy(consume(in, header.imageDigest.size()), header.imageDigest.begin());
+    header.previousTime = consume(in, consumeUint32(in));
+    return header;
+  }
+
+  /// Page size saved in the database header, big endian at offset 16 (1 means 65536)
+  std::size_t pageSizeOf(std::string_view header) {
+    if (header.size() < 100) throw std::runtime_error("Not a database image");
+    const std::size_t pageSize = (static_cast<unsigned char>(header[16]) << 8) | static_cast<unsigned char>(header[17]);
+    return pageSize == 1 ? 65536 : pageSize;
+  }
+
+  std::vector<char> readFile(const fs::path &file) {
+    std::ifstream ifs{file, std::ios::binary};
+    if (not ifs) throw std::runtime_error("Could not read " + file.string());
+    return {std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+  }
+}
+
+const Zstd &BackupChain::codec() {
+  static const Zstd zstd{kCompressionLevel};
+  return zstd;
+}
+
+std::optional<fs::path> BackupChain::save(const fs::path &snapshot) {
+  std::ifstream ifs{snapshot, std::ios::binary};
+  std::string page(100, '\0');
+  if (not ifs.read(page.data(), static_cast<std::streamsize>(page.size()))) {
+    throw std::runtime_error("Could not read database header of " + snapshot.string());
+  }
+  const std::size_t pageSize = pageSizeOf(page);
+  const std::uintmax_t size = fs::file_size(snapshot);
+  if (pageSize == 0 or size % pageSize != 0) {
+    throw std::runtime_error("Not a database image");
+  }
+  const std::size_t pageCount = size / pageSize;
+  page.resize(pageSize);
+  const auto readPage = [&](std::size_t index) -> std::string_view {
+    ifs.clear();
+    ifs.seekg(static_cast<std::streamoff>(index * pageSize));
+    if (not ifs.read(page.data(), static_cast<std::streamsize>(pageSize))) {
+      throw std::runtime_error("Could not read page " + std::to_string(index) + " of " + snapshot.string());
+    }
+    return page;
+  };
+
+  // Pages are told apart by SHA-256, a changed page left out of a delta would corrupt every later restore without notice
+  std::vector<Sha256::Digest> pageDigests(pageCount);
+  std::vector<std::uint32_t> changedPages{};
+  Sha256 imageDigest{};
+  for (std::size_t i = 0; i < pageCount; ++i) {
+    const std::string_view bytes = readPage(i);
+    pageDigests[i] = Sha256::of(bytes);
+    imageDigest.update(bytes);
+    if (i >= m_pageDigests.size() or pageDigests[i] != m_pageDigests[i]) {
+      changedPages.push_back(static_cast<std::uint32_t>(i));
+    }
+  }
+
+  const auto now = std::chrono::steady_clock::now();
+  const bool base = m_pageDigests.empty() or pageSize != m_pageSize or now - m_baseSavedAt >= kBaseInterval or changedPages.size() * 2 > pageCount;
+  if (not base and changedPages.empty() and pageCount == m_pageDigests.size()) {
+    return std::nullopt;
+  }
+
+  const std::string time = tgbotxx::DateTimeUtils::now("%Y-%m-%d-%H-%M-%S"); // 2024-03-25-22-00-01
+  const fs::path dir = m_backupsDir / time.substr(0, 4) / time.substr(5, 2) / time.substr(8, 2); // DbBackups/2024/03/25/
+  fs::create_directories(dir);
+  const fs::path file = dir / (std::string(kPrefix) + time + std::string(base ? kBaseExtension : kDeltaExtension));
+  if (base) {
+    writeCompressed(file, size, [&](Zstd::Writer &writer) {
+      for (std::size_t i = 0; i < pageCount; ++i)
+        writer.write(readPage(i));
+    });
+  } else {
+    const std::string header = encode(kDeltaMagic, DeltaHeader{
+                                                     .version = kDeltaVersion,
+                                                     .pageSize = static_cast<std::uint32_t>(pageSize),
+                                                     .pageCount = static_cast<std::uint32_t>(pageCount),
+                                                     .changedCount = static_cast<std::uint32_t>(changedPages.size()),
+                                                     .imageDigest = imageDigest.digest(),
+                                                     .previousTime = m_previousTime,
+                                                   });
+    writeCompressed(file, header.size() + changedPages.size() * (sizeof(std::uint32_t) + pageSize), [&](Zstd::Writer &writer) {
+      writer.write(header);
+      for (const std::uint32_t index: changedPages) {
+        std::string pageIndex{};
+        append(pageIndex, index);
+        writer.write(pageIndex);
+        writer.write(readPage(index));
+      }
+    });
+  }
+
+  // Only once saved, a failed save is followed by a delta of the last saved backup
+  m_pageSize = pageSize;
+  m_pageDigests = std::move(pageDigests);
+  m_previousTime = time;
+  if (base) m_baseSavedAt = now;
+  return file;
+}
+
+void BackupChain::writeCompressed(const fs::path &file, std::uint64_t size, const std::function<void(Zstd::Writer &)> &write) {
+  const fs::path partial = fs::path(file).concat(".part");
+  try {
+    std::ofstream ofs{partial, std::ios::binary};
+    Zstd::Writer writer{codec(), ofs, size, kCompressionWorkers};
+    write(writer);
+    writer.finish();
+  } catch (...) {
+    std::error_code ec{};
+    fs::remove(partial, ec);
+    throw;
+  }
+  fs::rename(partial, file);
+}
+
+std::string BackupChain::restore(const fs::path &backupsDir, const fs::path &output, const std::string &until) {
+  if (fs::exists(output)) {
+    throw std::runtime_error(output.string() + " already exists, restore into a new file");
+  }
+  const std::string last = until + '~'; // a prefix includes every time that starts with it, '~' sorts after digits and '-'
+
+  struct Backup {
+    std::string time;
+    fs::path file;
+    bool base;
+  };
+  std::vector<Backup> backups{};
+  for (const fs::directory_entry &entry: fs::recursive_directory_iterator(backupsDir)) {
+    const std::string name = entry.path().filename().string();
+    const bool base = name.ends_with(kBaseExtension), delta = name.ends_with(kDeltaExtension);
+    if (not name.starts_with(kPrefix) or (not base and not delta)) continue; // e.g older .tar.xz snapshots
+    std::string time = name.substr(kPrefix.size(), name.size() - kPrefix.size() - (base ? kBaseExtension : kDeltaExtension).size());
+    if (time <= last) {
+      backups.push_back(Backup{.time = std::move(time), .file = entry.path(), .base = base});
+    }
+  }
+  std::ranges::sort(backups, {}, &Backup::time);
+  const auto lastBase = std::ranges::find_if(backups.rbegin(), backups.rend(), &Backup::base);
+  if (lastBase == backups.rend()) {
+    throw std::runtime_error("No base backup found in " + backupsDir.string() + " before " + until);
+  }
+
+  std::string image = codec().decompress(readFile(lastBase->file));
+  std::string restoredTime = lastBase->time;
+  for (auto it = lastBase.base(); it != backups.end(); ++it) {
+    const std::string decompressed = codec().decompress(readFile(it->file));
+    std::string_view delta = decompressed;
+    DeltaHeader header{};
+    try {
+      header = decode(kDeltaMagic, delta);
+    } catch (const std::exception &e) {
+      throw std::runtime_error(it->file.string() + ": " + e.what());
+    }
+    if (header.version != kDeltaVersion) {
+      throw std::runtime_error(it->file.string() + " is a version " + std::to_string(header.version) + " backup delta, only version " + std::to_string(kDeltaVersion) + " is supported");
+    }
+    if (header.previousTime != restoredTime) {
+      throw std::runtime_error("Backups chain is broken, " + it->file.string() + " doesn't follow the backup of " + restoredTime);
+    }
+    image.resize(static_cast<std::size_t>(header.pageCount) * header.pageSize);
+    for (std::uint32_t i = 0; i < header.changedCount; ++i) {
+      const std::uint32_t page = consumeUint32(delta);
+      if (page >= header.pageCount) throw std::runtime_error("Corrupted backup delta " + it->file.string());
+      const std::string_view bytes = consume(delta, header.pageSize);
+      std::ranges::copy(bytes, image.begin() + static_cast<std::ptrdiff_t>(page) * header.pageSize);
+    }
+    if (Sha256::of(image) != header.imageDigest) {
+      throw std::runtime_error("Restored database doesn't match the backup of " + it->time + ", " + it->file.string() + " or a backup before it is corrupted");
+    }
+    restoredTime = it->time;
+  }
+
+  std::ofstream ofs{output, std::ios::binary};
+  ofs.write(image.data(), static_cast<std::streamsize>(image.size()));
+  if (not ofs) {
+    throw std::runtime_error("Could not write " + output.string());
+  }
+  return restoredTime;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "utils/Sha256.hpp"
+#include "utils/Zstd.hpp"
+
+namespace fs = std::filesystem;
+
+/// @brief Incremental database backups in a backups directory (res/DbBackups/YYYY/MM/DD/):
+/// base snapshots of the whole database (Database-<time>.db.zst, a standard zstd file) taken every kBaseInterval,
+/// and in between deltas holding only the pages that changed since the previous backup (Database-<time>.delta.zst).
+/// So backups write about as much as the database changed instead of the whole database every time.
+/// The database is restored to any backup time by applying the deltas that follow the latest base before it, in order (see restore()),
+/// each delta holds the SHA-256 of the whole database it leads to, so a restore that doesn't rebuild it exactly fails instead of writing a corrupted database.
+class BackupChain {
+public:
+  explicit BackupChain(fs::path backupsDir) : m_backupsDir(std::move(backupsDir)) {}
+
+  /// @brief Saves a consistent copy of the database (see Database::snapshot()) as a base snapshot, or as a delta of the previous save.
+  /// A base is saved first, then every kBaseInterval, or when most of the pages have changed anyway.
+  /// The copy is read one page at a time and streamed into the compressor, it's never loaded in memory.
+  /// @returns saved backup file, std::nullopt if the database hasn't changed since the previous save
+  std::optional<fs::path> save(const fs::path &snapshot);
+
+  /// @brief Rebuilds the database as it was at the latest backup taken at or before `until` into a new output file
+  /// @param until local time formatted as YYYY-MM-DD-HH-MM-SS like backups file names, a prefix such as "2024-03-25-23" works too
+  /// @returns time of the restored backup
+  static std::string restore(const fs::path &backupsDir, const fs::path &output, const std::string &until);
+
+private:
+  /// @brief Returns the backups compressor
+  static const Zstd &codec();
+  /// @brief Compresses size bytes written by write into file, through a .part file renamed once complete so an interrupted backup never looks like a valid one
+  static void writeCompressed(const fs::path &file, std::uint64_t size, const std::function<void(Zstd::Writer &)> &write);
+
+private:
+  fs::path m_backupsDir;
+  std::size_t m_pageSize{};
+  std::vector<Sha256::Digest> m_pageDigests{}; ///<! SHA-256 of each page of the previously saved image, empty until a base is saved
+  std::string m_previousTime{}; ///<! Time of the previously saved backup, the next delta applies on top of it
+  std::chrono::steady_clock::time_point m_baseSavedAt{};
+
+  inline static constexpr std::chrono::hours kBaseInterval = std::chrono::hours(24); ///<! A restore replays at most a day of deltas
+  inline static constexpr std::string_view kPrefix = "Database-";
+  inline static constexpr std::string_view kBaseExtension = ".db.zst";
+  inline static constexpr std::string_view kDeltaExtension = ".delta.zst";
+  inline static constexpr std::string_view kDeltaMagic = "GWBDELTA"; ///<! First bytes of a decompressed delta, followed by its header
+  inline static constexpr std::uint32_t kDeltaVersion = 1; ///<! Format version of deltas, saved right after kDeltaMagic
+  inline static constexpr int kCompressionLevel = 9; ///<! zstd level of backups
+  inline static constexpr int kCompressionWorkers = 2; ///<! zstd threads compressing backups, besides the backup thread
+};
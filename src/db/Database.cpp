@@ -1,175 +1,486 @@
 #include "Database.hpp"
+#include <future>
+#include <limits>
+#include <thread>
+#include "BackupChain.hpp"
 #include "log/Logger.hpp"
+#include "utils/BlockingQueue.hpp"
+#include "utils/FinalAction.hpp"
 
-std::mutex Database::m_mutex{};
+std::mutex Database::m_logsMutex{};
+std::atomic<std::shared_ptr<const Database::UserStatuses>> Database::m_userStatuses{};
 
-std::mutex &Database::getDbMutex() noexcept {
-  return m_mutex;
+struct Database::Writer {
+  BlockingQueue<std::packaged_task<void()>> queue{kMaxPendingWrites};
+  std::jthread thread{};
+
+  Writer() {
+    (void) getStorage(); // constructed first so the writer connection is closed after the writer thread is joined
+    thread = std::jthread([this] {
+      while (std::optional<std::packaged_task<void()>> task = queue.pop())
+        (*task)();
+    });
+  }
+  ~Writer() {
+    queue.close(); // writer thread applies pending writes then exits, it's joined right after
+  }
+
+  static Writer &instance() {
+    static Writer writer{};
+    return writer;
+  }
+};
+
+void Database::write(std::function<void()> mutation) {
+  Writer &writer = Writer::instance();
+  if (std::this_thread::get_id() == writer.thread.get_id()) {
+    mutation(); // nested write, already in order
+    return;
+  }
+  std::packaged_task<void()> task(std::move(mutation));
+  std::future<void> done = task.get_future();
+  if (not writer.queue.push(std::move(task))) {
+    throw std::runtime_error("Database writer is stopped");
+  }
+  done.get(); // rethrows mutation's exception
 }
 
 void Database::backup() {
-#ifdef _WIN32
-#error "TODO: Must adapt this function to windows too, or have an tar.xz library"
-#endif
-  try {
-    static const fs::path dbBackupsDir = fs::path(RES_DIR) / "DbBackups";
-    fs::path yearMonthDayDir = dbBackupsDir / tgbotxx::DateTimeUtils::now("%Y/%m/%d"); // DbBackups/2024/03/25/
-    if (!fs::exists(yearMonthDayDir)) fs::create_directories(yearMonthDayDir);
-    fs::path dbBackupFilename = yearMonthDayDir / ("Database-" + tgbotxx::DateTimeUtils::now("%Y-%m-%d-%H-%M-%S") + ".db"); // DbBackups/2024/03/25/Database-2024-03-25-22-00-01.db
-    getStorage().backup_to(dbBackupFilename.string());
-    // Compress Database-2024-...db into Database-2024-...db.tar.xz
-    // tar -cJf <archive.tar.xz> <files>
-    std::string cmd = "cd \"" + dbBackupFilename.parent_path().string() + "\" && tar -cJf \"" + dbBackupFilename.filename().string() + ".tar.xz\" \"" + dbBackupFilename.filename().string() + "\" --remove-files";
-    LOGI("Creating database backup tar.xz archive: " << cmd);
-    [[maybe_unused]] int rc = std::system(cmd.c_str());
-    LOGI("Backup " << rc << " " << (rc == EXIT_SUCCESS ? "success" : "failure"));
+  static std::atomic<bool> running{false};
+  static std::jthread job{}; // joined (and asked to stop) on exit
+  if (running.exchange(true)) {
+    LOGW("Previous database backup is still running, skipping this one");
+    return;
+  }
+  job = std::jthread([](std::stop_token stop) {
+    FinalAction done([]() noexcept { running = false; });
+    const fs::path backupsDir = fs::path(RES_DIR) / "DbBackups";
+    const fs::path snapshotFile = backupsDir / ".snapshot.db"; // not a backup file name, restore() ignores it
+    FinalAction removeSnapshot([&snapshotFile]() noexcept {
+      std::error_code ec{};
+      for (const char *suffix: {"", "-wal", "-shm"})
+        fs::remove(fs::path(snapshotFile).concat(suffix), ec);
+    });
+    try {
+      static BackupChain chain{backupsDir}; // remembers the previous backup's pages between runs
+      const auto start = std::chrono::steady_clock::now();
+      fs::create_directories(backupsDir);
+      if (not snapshot(stop, snapshotFile)) {
+        LOGW("Backup cancelled");
+        return;
+      }
+      const std::optional<fs::path> saved = chain.save(snapshotFile);
+      const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+      if (saved) {
+        LOGI("Backup success " << *saved << " (" << fs::file_size(*saved) << " bytes) in " << elapsed.count() << "ms");
+      } else {
+        LOGI("Database unchanged since the previous backup (checked in " << elapsed.count() << "ms)");
+      }
+    }
+    catch (const std::exception &err) {
+      LOGE("Could not backup database: " << err.what());
+    }
+  });
+}
+
+bool Database::snapshot(std::stop_token stop, const fs::path &file) {
+  using Connection = std::unique_ptr<sqlite3, decltype(&sqlite3_close)>;
+  const auto open = [](const std::string &filename, int flags) -> Connection {
+    sqlite3 *handle = nullptr;
+    const int rc = sqlite3_open_v2(filename.c_str(), &handle, flags, nullptr);
+    Connection connection{handle, &sqlite3_close};
+    if (rc != SQLITE_OK) {
+      throw std::runtime_error("Could not open " + filename + ": " + sqlite3_errmsg(handle));
+    }
+    return connection;
+  };
+  // Own connections, so the backup doesn't hold any of the storages connections for its whole duration
+  Connection source = open((fs::path(RES_DIR) / "Database.db").string(), SQLITE_OPEN_READONLY);
+  sqlite3_busy_timeout(source.get(), 5000);
+  fs::remove(file); // leftover of an interrupted backup
+  Connection copy = open(file.string(), SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+  // Pages go straight to the file through the copy's page cache (default 2MB), no journal since a failed copy is thrown away anyway
+  if (sqlite3_exec(copy.get(), "PRAGMA journal_mode=OFF; PRAGMA synchronous=OFF;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+    throw std::runtime_error(std::string("Could not prepare backup copy: ") + sqlite3_errmsg(copy.get()));
+  }
+
+  std::unique_ptr<sqlite3_backup, decltype(&sqlite3_backup_finish)> backup{sqlite3_backup_init(copy.get(), "main", source.get(), "main"), &sqlite3_backup_finish};
+  if (not backup) {
+    throw std::runtime_error(std::string("Could not start backup: ") + sqlite3_errmsg(copy.get()));
+  }
+  // In WAL mode a step only holds a read transaction, so writers never wait for the backup. A write from another connection
+  // restarts the backup though, so after kBackupMaxRestarts restarts the remaining pages are copied in a single step.
+  int rc = SQLITE_OK, restarts = 0, remaining = std::numeric_limits<int>::max();
+  while (rc == SQLITE_OK or rc == SQLITE_BUSY or rc == SQLITE_LOCKED) {
+    if (stop.stop_requested()) return false;
+    rc = sqlite3_backup_step(backup.get(), restarts < kBackupMaxRestarts ? kBackupStepPages : -1);
+    if (sqlite3_backup_remaining(backup.get()) > remaining) ++restarts;
+    remaining = sqlite3_backup_remaining(backup.get());
+    if (rc != SQLITE_DONE) std::this_thread::sleep_for(kBackupStepPause);
+  }
+  backup.reset(); // finish
+  if (rc != SQLITE_DONE) {
+    throw std::runtime_error(std::string("Backup failed: ") + sqlite3_errstr(rc));
+  }
+  copy.reset(); // close, every page is in the file
+  return true;
+}
+
+void Database::migrateLogs(sqlite3 *handle) {
+  // Logs.db LogsMigration row holds the id of the last migrated log, it's committed with each batch so an interrupted migration resumes after it
+  std::int64_t migratedUpTo = 0;
+  {
+    std::lock_guard guard{m_logsMutex}; // the LogWriter may be writing Logs.db already
+    auto &storage = getLogStorage();
+    if (std::unique_ptr<models::LogsMigration> progress = storage.get_pointer<models::LogsMigration>(models::LogsMigration::kId)) {
+      migratedUpTo = progress->migrated_up_to;
+    } else {
+      migratedUpTo = storage.pragma.user_version(); // saved there by earlier versions, which only held 32 bit ids
+    }
+  }
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(handle, R"(SELECT id, severity, shortMessage, longMessage, timestamp, filename, line, "column", functionName FROM Logs WHERE id > ? ORDER BY id)", -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return; // No Logs table, nothing to migrate
   }
-  catch (const std::exception &err) {
-    LOGE("Could not backup database: " << err.what());
+  sqlite3_bind_int64(stmt, 1, migratedUpTo);
+
+  const auto text = [stmt](int col) -> std::string {
+    const unsigned char *str = sqlite3_column_text(stmt, col);
+    return str ? reinterpret_cast<const char *>(str) : "";
+  };
+  constexpr std::size_t kBatchSize = 10'000;
+  std::vector<models::Log> batch{};
+  batch.reserve(kBatchSize);
+  std::size_t migrated = 0;
+  std::int64_t lastId = migratedUpTo;
+  const auto save = [&batch, &migrated, &lastId] {
+    std::lock_guard guard{m_logsMutex};
+    auto &storage = getLogStorage();
+    storage.transaction([&] {
+      for (const models::Log &log: batch)
+        storage.insert(log);
+      storage.replace(models::LogsMigration{.migrated_up_to = lastId});
+      return true; // commit
+    });
+    migrated += batch.size();
+    batch.clear();
+  };
+  int rc;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    lastId = sqlite3_column_int64(stmt, 0);
+    models::Log &log = batch.emplace_back();
+    log.severity = text(1);
+    log.shortMessage = text(2);
+    log.setLongMessage(text(3));
+    log.timestamp = sqlite3_column_int64(stmt, 4);
+    log.filename = text(5);
+    log.line = static_cast<std::uint_least32_t>(sqlite3_column_int64(stmt, 6));
+    log.column = static_cast<std::uint_least32_t>(sqlite3_column_int64(stmt, 7));
+    log.functionName = text(8);
+    if (batch.size() == kBatchSize) save();
   }
+  sqlite3_finalize(stmt);
+  if (rc != SQLITE_DONE) {
+    sqlite_orm::throw_translated_sqlite_error(handle);
+  }
+  save();
+
+  // Logs are safe in Logs.db, drop them from the main database and give the space back (auto_vacuum is off)
+  if (sqlite3_exec(handle, "DROP TABLE Logs; VACUUM;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+    sqlite_orm::throw_translated_sqlite_error(handle);
+  }
+  // The LogWriter only writes Logs.db, so logging while the main database opens doesn't reenter getStorage()
+  LOGI("Migrated " << migrated << " logs from Database.db to Logs.db" << (migratedUpTo ? " (resumed)" : ""));
 }
 
+void Database::beginWatchesMigration(sqlite3 *handle) {
+  sqlite3_stmt *stmt = nullptr;
+  const bool hasWatcherColumn = sqlite3_prepare_v2(handle, "SELECT watcher_id FROM Repositories LIMIT 1", -1, &stmt, nullptr) == SQLITE_OK;
+  sqlite3_finalize(stmt);
+  if (not hasWatcherColumn) return; // new database or already migrated
+
+  if (sqlite3_exec(handle, "ALTER TABLE Repositories RENAME TO Repositories_old;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+    sqlite_orm::throw_translated_sqlite_error(handle);
+  }
+}
+
+void Database::finishWatchesMigration(sqlite3 *handle) {
+  sqlite3_stmt *stmt = nullptr;
+  const bool hasOldTable = sqlite3_prepare_v2(handle, "SELECT 1 FROM Repositories_old LIMIT 1", -1, &stmt, nullptr) == SQLITE_OK;
+  sqlite3_finalize(stmt);
+  if (not hasOldTable) return;
+
+  // Keep the most recently updated snapshot of each repository. Columns added after the original schema (polling
+  // schedule, validators...) are left to their defaults, so every repository is simply polled again on the next cycle.
+  // Statements run one by one to count the rows each INSERT migrated.
+  const auto exec = [handle](const char *sql) -> int {
+    if (sqlite3_exec(handle, sql, nullptr, nullptr, nullptr) != SQLITE_OK) {
+      const std::string error = sqlite3_errmsg(handle);
+      sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr);
+      throw std::runtime_error("Failed to migrate repositories: " + error);
+    }
+    return sqlite3_changes(handle);
+  };
+  exec("BEGIN;");
+  const int repositories = exec("INSERT OR IGNORE INTO Repositories(id, full_name, stargazers_count, watchers_count, open_issues_count, pulls_count, forks_count, description, size, language, createdAt, updatedAt)"
+                                " SELECT id, full_name, stargazers_count, watchers_count, open_issues_count, pulls_count, forks_count, description, size, language, createdAt, updatedAt"
+                                " FROM Repositories_old ORDER BY updatedAt DESC;");
+  const int watches = exec("INSERT OR IGNORE INTO Watches(user_id, repo_id, createdAt)"
+                           " SELECT watcher_id, id, createdAt FROM Repositories_old WHERE watcher_id IS NOT NULL;");
+  exec("DROP TABLE Repositories_old;");
+  exec("COMMIT;");
+  LOGI("Migrated " << repositories << " repositories and " << watches << " watches to the Repositories and Watches tables");
+}
+
+void Database::loadUsersCache() {
+  write([] {
+    m_userStatuses.store(selectUserStatuses());
+  });
+}
+
+std::shared_ptr<Database::UserStatuses> Database::selectUserStatuses() {
+  auto statuses = std::make_shared<UserStatuses>();
+  for (const auto &[id, status]: getStorage().select(columns(&models::User::id, &models::User::status))) {
+    statuses->emplace(id, status);
+  }
+  return statuses;
+}
+
+void Database::cacheUserStatus(const models::UserId userId, const models::UserStatus status) {
+  std::shared_ptr<const UserStatuses> current = m_userStatuses.load();
+  // Without a cache yet, publish every user, not just this one: a cache missing users would make them look unknown
+  auto statuses = current ? std::make_shared<UserStatuses>(*current) : selectUserStatuses();
+  (*statuses)[userId] = status;
+  m_userStatuses.store(std::move(statuses));
+}
+
+std::optional<models::UserStatus> Database::getUserStatus(const models::UserId userId) {
+  std::shared_ptr<const UserStatuses> statuses = m_userStatuses.load();
+  if (not statuses) [[unlikely]] {
+    loadUsersCache();
+    statuses = m_userStatuses.load();
+  }
+  if (auto it = statuses->find(userId); it != statuses->end())
+    return it->second;
+  return std::nullopt;
+}
+
+void Database::createIndexes(sqlite3 *handle) {
+  // Watches primary key (user_id, repo_id) already covers lookups by user, this one covers lookups by repository.
+  // Repositories are looked up by case insensitive full name, index the exact lower(full_name) expression the queries use.
+  int rc = sqlite3_exec(handle, "CREATE INDEX IF NOT EXISTS idx_watches_repo_id ON Watches(repo_id, user_id);"
+                                "CREATE INDEX IF NOT EXISTS idx_repositories_lower_full_name ON Repositories(lower(full_name));",
+                        nullptr, nullptr, nullptr);
+  if (rc != SQLITE_OK) {
+    sqlite_orm::throw_translated_sqlite_error(handle);
+  }
+}
 
 bool Database::userExists(const UserId userId) {
-  std::lock_guard guard{m_mutex};
-  return !!getStorage().count<models::User>(where(c(&models::User::id) == userId));
+  return getUserStatus(userId).has_value();
 }
 
 models::User Database::getUser(const models::UserId userId) {
-  std::lock_guard guard{m_mutex};
-  return getStorage().get<models::User>(userId);
+  return getReadStorage().get<models::User>(userId);
 }
 
 void Database::addUser(const models::User &newUser) {
-  std::lock_guard guard{m_mutex};
-  getStorage().replace(newUser);
-}
-
-models::UserStatus Database::getUserStatus(const UserId userId) {
-  std::lock_guard guard{m_mutex};
-  // *  Select a single column into std::vector<T> or multiple columns into std::vector<std::tuple<...>>.
-  // *  For a single column use `auto rows = storage.select(&User::id, where(...));
-  // *  For multicolumns use `auto rows = storage.select(columns(&User::id, &User::name), where(...));
-  // TODO: open issue in sqlite orm: single column select doesn't work with enums.
-  //auto statuses = getStorage().select(&models::User::status, where(c(&models::User::id) == userId));
-  //auto [status] = statuses.front();
-  auto statuses = getStorage().select(columns(&models::User::status), where(c(&models::User::id) == userId));
-  auto [status] = statuses.front();
-  return status;
+  write([&newUser] {
+    getStorage().replace(newUser);
+    cacheUserStatus(newUser.id, newUser.status);
+  });
 }
 
 void Database::updateUserStatus(const models::UserId userId, const models::UserStatus newStatus) {
-  std::lock_guard guard{m_mutex};
-  getStorage().update_all(
-    set(
-      c(&models::User::status) = newStatus,
-      c(&models::User::updatedAt) = std::time(nullptr)
-    ),
-    where(c(&models::User::id) == userId)
-  );
+  write([userId, newStatus] {
+    getStorage().update_all(
+      set(
+        c(&models::User::status) = newStatus,
+        c(&models::User::updatedAt) = std::time(nullptr)
+      ),
+      where(c(&models::User::id) == userId)
+    );
+    cacheUserStatus(userId, newStatus);
+  });
 }
 
 void Database::updateUser(const models::User &updatedUser) {
-  std::lock_guard guard{m_mutex};
-  getStorage().update(updatedUser);
+  write([&updatedUser] {
+    getStorage().update(updatedUser);
+    cacheUserStatus(updatedUser.id, updatedUser.status);
+  });
 }
 
-int Database::userReposCount(const UserId userId) {
-  std::lock_guard guard{m_mutex};
-  return Database::getStorage().count<models::Repository>(
+std::size_t Database::userReposCount(const UserId userId) {
+  // Hot queries are compiled once per reading thread (like its connection) and only rebound on each call
+  thread_local auto statement = getReadStorage().prepare(count<models::Watch>(
     where(
-      c(&Repository::watcher_id) == userId
+      c(&Watch::user_id) == userId
     )
-  );
+  ));
+  get<0>(statement) = userId;
+  return static_cast<std::size_t>(getReadStorage().execute(statement));
 }
 
 bool Database::repoExists(const models::RepositoryId repoId) {
-  std::lock_guard guard{m_mutex};
-  return !!getStorage().count<models::Repository>(where(c(&models::Repository::id) == repoId));
+  thread_local auto statement = getReadStorage().prepare(count<models::Repository>(where(c(&models::Repository::id) == repoId)));
+  get<0>(statement) = repoId;
+  return !!getReadStorage().execute(statement);
 }
 
-bool Database::repoExistsByFullName(const std::string &full_name) {
-  std::lock_guard guard{m_mutex};
-  return !!getStorage().count<models::Repository>(
-    where(lower(&models::Repository::full_name) == tgbotxx::StringUtils::toLowerCopy(full_name))
-  );
+std::optional<models::Repository> Database::findRepoByFullName(const std::string &full_name) {
+  thread_local auto statement = getReadStorage().prepare(get_all<models::Repository>(
+    where(lower(&models::Repository::full_name) == tgbotxx::StringUtils::toLowerCopy(full_name)),
+    limit(1)
+  ));
+  get<0>(statement) = tgbotxx::StringUtils::toLowerCopy(full_name);
+  std::vector<models::Repository> repos = getReadStorage().execute(statement);
+  if (repos.empty()) return std::nullopt;
+  return std::move(repos.front());
 }
 
-void Database::addRepo(const models::Repository &newRepo) {
-  std::lock_guard guard{m_mutex};
-  Database::getStorage().replace(newRepo);
-}
-
-void Database::updateRepo(const models::Repository &newRepo) {
-  std::lock_guard guard{m_mutex};
-  /**
-   *  Update routine. Sets all non primary key fields where primary key is equal.
-   *  O is an object type. May be not specified explicitly cause it can be deduced by
-   *      compiler from first parameter.
-   *  @param o object to be updated.
-   *
-   *  But the bad thing is Repository has no primary key, even tried combining id & watcher id in one pk but doesn't work with sqlite_orm.
-   */
-  //  Database::getStorage().update(newRepo);
-  Database::getStorage().update_all(
-    set(
-      c(&Repository::full_name) = newRepo.full_name,
-      c(&Repository::stargazers_count) = newRepo.stargazers_count,
-      c(&Repository::watchers_count) = newRepo.watchers_count,
-      c(&Repository::open_issues_count) = newRepo.open_issues_count,
-      c(&Repository::pulls_count) = newRepo.pulls_count,
-      c(&Repository::forks_count) = newRepo.forks_count,
-      c(&Repository::description) = newRepo.description,
-      c(&Repository::size) = newRepo.size,
-      c(&Repository::language) = newRepo.language,
-      c(&Repository::updatedAt) = std::time(nullptr) // Don't forget
-    ),
-    where(c(&Repository::watcher_id) == *newRepo.watcher_id and c(&Repository::id) == newRepo.id)
-  );
+void Database::updateRepo(const models::Repository &updatedRepo) {
+  write([&updatedRepo] {
+    models::Repository repo = updatedRepo;
+    repo.updatedAt = std::time(nullptr); // Don't forget
+    getStorage().update(repo);
+  });
 }
 
-void Database::removeUserRepo(const models::UserId watcherId, const models::RepositoryId repoId) {
-  std::lock_guard guard{m_mutex};
-  getStorage().remove_all<models::Repository>(
-    where(c(&models::Repository::watcher_id) == watcherId and c(&Repository::id) == repoId)
-  );
+void Database::updateRepoSchedule(const models::RepositoryId repoId, const std::time_t nextPollAt, const std::int64_t pollInterval, const std::time_t lastChangedAt) {
+  write([=] {
+    static auto statement = getStorage().prepare(update_all(
+      set(
+        c(&Repository::next_poll_at) = nextPollAt,
+        c(&Repository::poll_interval) = pollInterval,
+        c(&Repository::last_changed_at) = lastChangedAt
+      ),
+      where(c(&Repository::id) == repoId)
+    ));
+    get<0>(statement) = nextPollAt;
+    get<1>(statement) = pollInterval;
+    get<2>(statement) = lastChangedAt;
+    get<3>(statement) = repoId;
+    getStorage().execute(statement);
+  });
+}
+
+void Database::updateRepos(const std::vector<models::Repository> &updatedRepos, const std::vector<models::Repository> &rescheduledRepos) {
+  write([&] {
+    getStorage().transaction([&] {
+      for (const models::Repository &repo: updatedRepos) {
+        updateRepo(repo);
+      }
+      for (const models::Repository &repo: rescheduledRepos) {
+        updateRepoSchedule(repo.id, repo.next_poll_at, repo.poll_interval, repo.last_changed_at);
+      }
+      return true; // commit
+    });
+  });
 }
 
 void Database::iterateRepos(const std::function<void(const models::Repository &)> &callback) {
-  m_mutex.lock();
-  auto range = Database::getStorage().iterate<models::Repository>();
-  m_mutex.unlock();
+  for (const models::Repository &repo: getReadStorage().iterate<models::Repository>()) {
+    callback(repo);
+  }
+}
+
+void Database::addUserRepo(const models::UserId watcherId, const models::Repository &repo) {
+  write([&] {
+    getStorage().transaction([&] {
+      // Other watchers' snapshot is kept if the repository is already watched, so none of their pending changes is lost
+      if (not getStorage().count<models::Repository>(where(c(&models::Repository::id) == repo.id))) {
+        getStorage().replace(repo);
+      }
+      getStorage().replace(models::Watch{.user_id = watcherId, .repo_id = repo.id, .createdAt = std::time(nullptr)});
+      return true; // commit
+    });
+  });
+}
 
-  for (auto begin = range.begin(); begin != range.end();) {
-    callback(*begin);
+void Database::removeUserRepo(const models::UserId watcherId, const models::RepositoryId repoId) {
+  write([=] {
+    getStorage().transaction([=] {
+      getStorage().remove_all<models::Watch>(
+        where(c(&Watch::user_id) == watcherId and c(&Watch::repo_id) == repoId)
+      );
+      if (not getStorage().count<models::Watch>(where(c(&Watch::repo_id) == repoId))) {
+        getStorage().remove_all<models::Repository>(where(c(&Repository::id) == repoId));
+      }
+      return true; // commit
+    });
+  });
+}
 
-    m_mutex.lock();
-    begin++;
-    m_mutex.unlock();
-  }
+bool Database::userWatchesRepoByFullName(const models::UserId watcherId, const std::string &full_name) {
+  thread_local auto statement = getReadStorage().prepare(count<models::Repository>(
+    where(
+      lower(&models::Repository::full_name) == tgbotxx::StringUtils::toLowerCopy(full_name) and
+      in(&Repository::id, select(&Watch::repo_id, where(c(&Watch::user_id) == watcherId)))
+    )
+  ));
+  get<0>(statement) = tgbotxx::StringUtils::toLowerCopy(full_name);
+  get<1>(statement) = watcherId;
+  return !!getReadStorage().execute(statement);
+}
 
+std::unordered_map<models::RepositoryId, std::vector<models::UserId>> Database::getReposWatchers() {
+  std::unordered_map<models::RepositoryId, std::vector<models::UserId>> watchers{};
+  for (const auto &[repoId, userId]: getReadStorage().select(columns(&Watch::repo_id, &Watch::user_id))) {
+    watchers[repoId].push_back(userId);
+  }
+  return watchers;
 }
 
 std::vector<std::string> Database::getUserReposFullnames(const models::UserId watcherId) {
-  std::lock_guard guard{m_mutex};
-  return getStorage().select(&Repository::full_name,
+  return getReadStorage().select(&Repository::full_name,
                              where(
-                               c(&Repository::watcher_id) == watcherId
+                               in(&Repository::id, select(&Watch::repo_id, where(c(&Watch::user_id) == watcherId)))
                              ),
                              order_by(&Repository::full_name)
   );
 }
 
 std::vector<models::Repository> Database::getUserRepos(const models::UserId watcherId) {
-  std::lock_guard guard{m_mutex};
-  return Database::getStorage().get_all<models::Repository>(
+  return getReadStorage().get_all<models::Repository>(
     where(
-      c(&Repository::watcher_id) == watcherId
+      in(&Repository::id, select(&Watch::repo_id, where(c(&Watch::user_id) == watcherId)))
     )
   );
 }
 
-std::int64_t Database::addLog(const models::Log& newLog) {
-  std::lock_guard guard{m_mutex};
-  return getStorage().insert(newLog);
+void Database::addLogs(const std::vector<models::Log> &newLogs) {
+  if (newLogs.empty()) return;
+  std::lock_guard guard{m_logsMutex};
+  getLogStorage().transaction([&newLogs] {
+    for (const models::Log &newLog: newLogs)
+      getLogStorage().insert(newLog);
+    return true; // commit
+  });
+}
+
+std::size_t Database::pruneLogs(const std::time_t olderThan, const std::uintmax_t maxSizeBytes) {
+  std::lock_guard guard{m_logsMutex};
+  auto &storage = getLogStorage();
+  storage.remove_all<models::Log>(where(c(&models::Log::timestamp) < olderThan));
+  std::size_t removed = static_cast<std::size_t>(storage.changes());
+
+  // The file only shrinks on checkpoints, so size is rechecked on the next prune rather than in a loop
+  const fs::path logsDb = fs::path(RES_DIR) / "Logs.db";
+  std::error_code ec{};
+  const std::uintmax_t size = fs::file_size(logsDb, ec);
+  if (not ec and size > maxSizeBytes) {
+    // Remove the oldest logs proportionally to how much the file is over its max size (+10% to avoid pruning again right away)
+    const std::size_t count = storage.count<models::Log>();
+    const double overRatio = 1.0 - static_cast<double>(maxSizeBytes) / static_cast<double>(size) + 0.1;
+    const std::size_t oldest = std::min(count, static_cast<std::size_t>(static_cast<double>(count) * overRatio));
+    if (oldest) {
+      storage.remove_all<models::Log>(
+        where(in(&models::Log::id, select(&models::Log::id, order_by(&models::Log::id), limit(oldest))))
+      );
+      removed += static_cast<std::size_t>(storage.changes());
+    }
+  }
+  return removed;
 }
@@ -2,40 +2,64 @@
 
 #include "models/User.hpp"
 #include "models/Repository.hpp"
+#include "models/Watch.hpp"
 #include "models/Log.hpp"
+#include "models/LogsMigration.hpp"
 #include "tgbotxx/utils/DateTimeUtils.hpp"
 #include "sqlite_orm/sqlite_orm.h"
+#include <atomic>
+#include <chrono>
 #include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stop_token>
+#include <unordered_map>
 
 namespace fs = std::filesystem;
 using namespace sqlite_orm;
 using namespace models;
 
+/// @brief Database access.
+/// Writes are applied in order by a single writer thread on the writer connection (see write()), while reads run in parallel
+/// on a read-only connection per reading thread (see getReadStorage()). In WAL mode readers never block the writer nor each other,
+/// so user facing reads don't queue behind watchdog writes.
 class Database {
 private:
-  static std::mutex m_mutex;
+  static std::mutex m_logsMutex; ///<! Guards the logs storage, so logging never waits on user queries
 
-public:
-  /// @brief Returns Database mutex to be used by multiple threads for
-  /// writing/reading into/from the database. 
-  [[nodiscard]] static std::mutex &getDbMutex() noexcept;
+  using UserStatuses = std::unordered_map<models::UserId, models::UserStatus>;
+  /// Cache of every user's status, read lock-free by getUserStatus() and userExists().
+  /// Users are written rarely, so the writer thread publishes an updated copy of the whole map.
+  static std::atomic<std::shared_ptr<const UserStatuses>> m_userStatuses;
+
+  struct Writer; ///<! Writer thread applying write() mutations in order
+  inline static constexpr std::size_t kMaxPendingWrites = 1024; ///<! write() callers wait once this many writes are queued
+  inline static constexpr int kBackupStepPages = 256; ///<! Pages copied per sqlite3_backup_step(), the source is only read locked during a step
+  inline static constexpr std::chrono::milliseconds kBackupStepPause = std::chrono::milliseconds(5); ///<! Breath between two backup steps
+  inline static constexpr int kBackupMaxRestarts = 3; ///<! Writes restart a stepped backup, after that many restarts the rest is copied in one step
+
+  /// @brief Returns a new (not yet opened) storage of the main database
+  static auto makeStorage() {
+    return make_storage(fs::path(RES_DIR) / "Database.db",
+                        Repository::table(),
+                        User::table(),
+                        Watch::table()
+    );
+  }
 
 public:
-  /// @brief Returns create database storage.
-  /// It creates it if not already created, also syncs the db schema. 
+  /// @brief Returns the writer connection storage, it creates it if not already created, also syncs the db schema.
+  /// @note Only use it through write() (or on open), reads go through getReadStorage()
   static auto& getStorage() {
-    static auto storage = make_storage(fs::path(RES_DIR) / "Database.db",
-                                       Repository::table(),
-                                       User::table(),
-                                       Log::table()
-    );
+    static auto storage = makeStorage();
     static bool schemaSynced = false;
-    if (!storage.on_open) {
+    static const bool opened = [] {
       storage.on_open = []([[maybe_unused]] sqlite3 *handle) {
         if (not schemaSynced) {
           int rc = sqlite3_exec(handle, "PRAGMA synchronous=NORMAL;" // wait for data to be written to disk io
-                                        "PRAGMA locking_mode=EXCLUSIVE;" // Only 1 connection can write to db at a time, others will be blocked
-                                        "PRAGMA journal_mode=WAL;" // record changes before they are applied to the main database file
+                                        "PRAGMA busy_timeout=5000;" // wait for readers opening the database (WAL recovery) instead of failing
+                                        "PRAGMA journal_mode=WAL;" // record changes before they are applied to the main database file, readers keep reading while we write
                                         "PRAGMA cache_size=50000;" // 50000=50mb 800000=800MB (default -2000 which is 2kb)
                                         "PRAGMA temp_store=MEMORY;" // Storing temporary tables and indices in memory can improve performance, but it can also increase memory usage and the risk of running out of memory, especially for large temporary datasets.
                                         "PRAGMA auto_vacuum=0;", // DO NOT Vacuum
@@ -43,55 +67,159 @@ public:
           if (rc != SQLITE_OK) {
             sqlite_orm::throw_translated_sqlite_error(handle);
           }
+          migrateLogs(handle);
+          beginWatchesMigration(handle);
           storage.sync_schema(/*preserve*/true); // PRESERVE=TRUE Don't delete my table data when I add a new column in a table. (https://github.com/fnc12/sqlite_orm/issues/1261)
+          finishWatchesMigration(handle);
+          createIndexes(handle);
           schemaSynced = true;
         }
       };
-    }
+      storage.open_forever(); // single long lived writer connection, its prepared statements live as long
+      return true;
+    }();
+    (void) opened;
+    return storage;
+  }
+
+  /// @brief Returns the calling thread's read-only connection storage to the main database.
+  /// Each reading thread gets its own connection (opened on first read, closed when the thread exits), so reads scale with threads.
+  static auto& getReadStorage() {
+    (void) getStorage(); // schema must be synced by the writer connection before anything reads
+    thread_local auto storage = makeStorage();
+    thread_local const bool opened = [] {
+      storage.on_open = []([[maybe_unused]] sqlite3 *handle) {
+        int rc = sqlite3_exec(handle, "PRAGMA query_only=1;" // reads only, all writes go through the writer thread
+                                      "PRAGMA busy_timeout=5000;"
+                                      "PRAGMA cache_size=-8000;" // 8MB per reader
+                                      "PRAGMA temp_store=MEMORY;",
+                              nullptr, nullptr, nullptr);
+        if (rc != SQLITE_OK) {
+          sqlite_orm::throw_translated_sqlite_error(handle);
+        }
+      };
+      storage.open_forever();
+      return true;
+    }();
+    (void) opened;
     return storage;
   }
 
-  /// @brief Call this periodically to backup the database in res/DbBackups/ periodically
+  /// @brief Runs mutation on the writer thread, in the order writes were submitted, and waits for it to complete.
+  /// Exceptions thrown by mutation are rethrown to the caller.
+  static void write(std::function<void()> mutation);
+
+  /// @brief Returns logs database storage (res/Logs.db).
+  /// Logs live in their own file so the main database and its backups stay small, they are pruned by the LogWriter with pruneLogs().
+  static auto& getLogStorage() {
+    static auto storage = make_storage(fs::path(RES_DIR) / "Logs.db",
+                                       Log::table(),
+                                       LogsMigration::table()
+    );
+    static bool schemaSynced = false;
+    static const bool opened = [] {
+      storage.on_open = []([[maybe_unused]] sqlite3 *handle) {
+        if (not schemaSynced) {
+          int rc = sqlite3_exec(handle, "PRAGMA auto_vacuum=FULL;" // give pages of pruned logs back to the file system on commit (must be set before tables are created)
+                                        "PRAGMA synchronous=NORMAL;"
+                                        "PRAGMA journal_mode=WAL;",
+                                nullptr, nullptr, nullptr);
+          if (rc != SQLITE_OK) {
+            sqlite_orm::throw_translated_sqlite_error(handle);
+          }
+          storage.sync_schema(/*preserve*/true);
+          rc = sqlite3_exec(handle, "CREATE INDEX IF NOT EXISTS idx_logs_timestamp ON Logs(timestamp);", // retention by age
+                            nullptr, nullptr, nullptr);
+          if (rc != SQLITE_OK) {
+            sqlite_orm::throw_translated_sqlite_error(handle);
+          }
+          schemaSynced = true;
+        }
+      };
+      storage.open_forever(); // only the LogWriter thread writes logs, keep one connection instead of reopening the file every batch
+      return true;
+    }();
+    (void) opened;
+    return storage;
+  }
+
+  /// @brief Call this periodically to backup the database in res/DbBackups/ periodically, as a base snapshot or a delta of the previous backup (see BackupChain).
+  /// The backup runs on a background thread and returns immediately, it's skipped if the previous backup is still running.
   static void backup();
 
+private:
+  /// @brief Copies the database with sqlite3_backup_step() kBackupStepPages pages at a time into file, a consistent copy to read the backup from.
+  /// Pages are written to the file as they are copied, so memory use doesn't grow with the database [backup thread]
+  /// @returns false if stop was requested before the copy completed
+  static bool snapshot(std::stop_token stop, const fs::path& file);
+  /// @brief Reads every user's status from the database [writer thread]
+  static std::shared_ptr<UserStatuses> selectUserStatuses();
+  /// @brief Publishes a copy of the users cache with user's status set, loading the whole cache if it isn't yet [writer thread]
+  static void cacheUserStatus(const models::UserId userId, const models::UserStatus status);
+  /// @brief Databases created before the Watches table had one Repositories row per (repository, watcher) pair,
+  /// renames that table to Repositories_old so sync_schema() creates the new Repositories table [once, on open]
+  static void beginWatchesMigration(sqlite3 *handle);
+  /// @brief Moves Repositories_old rows into Repositories (one row per repository) and Watches, then drops it [once, on open]
+  static void finishWatchesMigration(sqlite3 *handle);
+  /// @brief Creates indexes of the hot queries that sqlite_orm can't express in the schema (e.g expression indexes) [on open, after sync_schema()]
+  static void createIndexes(sqlite3 *handle);
+  /// @brief Moves the Logs table of databases created before logs got their own file into Logs.db, then shrinks the main database [once, on open].
+  /// Resumes after the last migrated log if a previous migration was interrupted.
+  static void migrateLogs(sqlite3 *handle);
+
 public: // Users
-  /// @brief Returns true if User with id exists in the database
+  /// @brief Loads all users statuses into the in-memory users cache. Called once at startup, it's also loaded on first use otherwise.
+  static void loadUsersCache();
+  /// @brief Returns User's status, or std::nullopt if User doesn't exist [lock-free, from users cache]
+  static std::optional<models::UserStatus> getUserStatus(const models::UserId userId);
+  /// @brief Returns true if User with id exists in the database [lock-free, from users cache]
   static bool userExists(const models::UserId userId);
   /// @brief Returns User object by id
   /// @note Call userExists() first before calling this function
   static models::User getUser(const models::UserId userId);
   /// @brief Adds a new user to the database
   static void addUser(const models::User& newUser);
-  /// @brief Returns UserStatus by id
-  static models::UserStatus getUserStatus(const models::UserId userId);
   /// @brief Update User's status by id
   static void updateUserStatus(const models::UserId userId, const models::UserStatus newStatus);
   /// @brief Updates existing user changed properties
   static void updateUser(const models::User& updatedUser);
   /// @brief Returns the count of repositories this user is watching
-  static int userReposCount(const models::UserId userId);
+  static std::size_t userReposCount(const models::UserId userId);
 
 public: // Repositories
   /// @brief Returns true if a Repository exists with same id
   static bool repoExists(const models::RepositoryId repoId);
-  /// @brief Returns true if Repository exists with same full_name (example: "torvalds/linux")
-  static bool repoExistsByFullName(const std::string& full_name);
-  /// @brief Adds a new Repository object to the database
-  static void addRepo(const models::Repository& newRepo);
-  /// @brief Updates existing repository changed properties
+  /// @brief Returns Repository with full_name (case insensitive, example: "torvalds/linux") if any user watches it
+  static std::optional<models::Repository> findRepoByFullName(const std::string& full_name);
+  /// @brief Updates existing repository, all of its columns
   static void updateRepo(const models::Repository& updatedRepo);
-  /// @brief Removes Repository from User's watch list
-  static void removeUserRepo(const models::UserId watcherId, const models::RepositoryId repoId);
-  /// @brief Lock secure iterate over repositories to not hold the db mutex for a long time
+  /// @brief Updates polling schedule of a repository
+  static void updateRepoSchedule(const models::RepositoryId repoId, const std::time_t nextPollAt, const std::int64_t pollInterval, const std::time_t lastChangedAt);
+  /// @brief Updates repositories (all of their columns) and polling schedules of rescheduledRepos in a single transaction
+  static void updateRepos(const std::vector<models::Repository>& updatedRepos, const std::vector<models::Repository>& rescheduledRepos);
+  /// @brief Iterates over all repositories on the calling thread's read connection, without blocking writes
   /// @note Use this instead of getStorage().iterate<Repository>()
   static void iterateRepos(const std::function<void(const models::Repository&)>& callback);
+
+public: // Watches
+  /// @brief Adds Repository to User's watch list, the repository is stored if no other user watches it yet
+  static void addUserRepo(const models::UserId watcherId, const models::Repository& repo);
+  /// @brief Removes Repository from User's watch list, the repository is removed too if no other user watches it
+  static void removeUserRepo(const models::UserId watcherId, const models::RepositoryId repoId);
+  /// @brief Returns true if User is watching Repository with full_name (case insensitive, example: "torvalds/linux")
+  static bool userWatchesRepoByFullName(const models::UserId watcherId, const std::string& full_name);
+  /// @brief Returns users watching each repository
+  static std::unordered_map<models::RepositoryId, std::vector<models::UserId>> getReposWatchers();
   /// @brief Returns full names of all repositories that a User is watching
   static std::vector<std::string> getUserReposFullnames(const models::UserId watcherId);
   /// @brief Returns all Repositories objects that a User is watching
   static std::vector<models::Repository> getUserRepos(const models::UserId watcherId);
 
 public: // Logs
-  /// @brief Adds a new Log object to the database
-  static std::int64_t addLog(const models::Log& newLog);
+  /// @brief Adds a batch of new Log objects to the logs database in a single transaction [LogWriter thread]
+  static void addLogs(const std::vector<models::Log>& newLogs);
+  /// @brief Removes logs older than olderThan, then the oldest logs until the logs database file is no larger than maxSizeBytes [LogWriter thread]
+  /// @returns number of removed logs
+  static std::size_t pruneLogs(const std::time_t olderThan, const std::uintmax_t maxSizeBytes);
 };
 
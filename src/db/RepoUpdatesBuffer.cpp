@@ -0,0 +1,40 @@
+#include "RepoUpdatesBuffer.hpp"
+#include <exception>
+#include <utility>
+#include "Database.hpp"
+#include "log/Logger.hpp"
+
+RepoUpdatesBuffer::~RepoUpdatesBuffer() {
+  try {
+    flush();
+  } catch (const std::exception &e) {
+    LOGE("Failed to save repositories updates: " << e.what());
+  }
+}
+
+void RepoUpdatesBuffer::update(const models::Repository &repo) {
+  if (not pending()) m_oldestPendingAt = std::chrono::steady_clock::now();
+  m_updatedRepos.push_back(repo);
+  flushIfDue();
+}
+
+void RepoUpdatesBuffer::updateSchedule(const models::Repository &repo) {
+  if (not pending()) m_oldestPendingAt = std::chrono::steady_clock::now();
+  m_rescheduledRepos.push_back(repo);
+  flushIfDue();
+}
+
+void RepoUpdatesBuffer::flush() {
+  if (not pending()) return;
+  // Taken out first so a failed flush isn't retried by the destructor, dropped repositories are simply polled again
+  const std::vector<models::Repository> updatedRepos = std::exchange(m_updatedRepos, {});
+  const std::vector<models::Repository> rescheduledRepos = std::exchange(m_rescheduledRepos, {});
+  Database::updateRepos(updatedRepos, rescheduledRepos);
+  LOGT("Saved " << updatedRepos.size() << " updated and " << rescheduledRepos.size() << " rescheduled repositories");
+}
+
+void RepoUpdatesBuffer::flushIfDue() {
+  if (pending() >= kMaxPendingUpdates or std::chrono::steady_clock::now() - m_oldestPendingAt >= kMaxFlushDelay) {
+    flush();
+  }
+}
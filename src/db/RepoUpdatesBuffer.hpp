@@ -0,0 +1,42 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <vector>
+#include "models/Repository.hpp"
+
+/// @brief Write-behind buffer of the watchdog's repository updates.
+/// Updates are kept in memory and saved together in a single transaction once kMaxPendingUpdates repositories are pending
+/// or the oldest pending update is kMaxFlushDelay old, so a polling cycle costs a handful of commits instead of one per repository.
+/// Pending updates are flushed on destruction. Not thread safe, it's owned by the watchdog's diff stage.
+class RepoUpdatesBuffer {
+public:
+  RepoUpdatesBuffer() = default;
+  ~RepoUpdatesBuffer();
+
+  RepoUpdatesBuffer(const RepoUpdatesBuffer &) = delete;
+  RepoUpdatesBuffer &operator=(const RepoUpdatesBuffer &) = delete;
+
+  /// @brief Queues an update of all repo's columns (see Database::updateRepo())
+  void update(const models::Repository &repo);
+  /// @brief Queues an update of repo's polling schedule only (see Database::updateRepoSchedule())
+  void updateSchedule(const models::Repository &repo);
+  /// @brief Saves all pending updates in a single transaction
+  void flush();
+
+  /// @brief Returns count of updates not saved yet
+  [[nodiscard]] std::size_t pending() const noexcept {
+    return m_updatedRepos.size() + m_rescheduledRepos.size();
+  }
+
+private:
+  /// @brief Flushes if too many updates are pending or they have been pending for too long
+  void flushIfDue();
+
+private:
+  std::vector<models::Repository> m_updatedRepos{};
+  std::vector<models::Repository> m_rescheduledRepos{};
+  std::chrono::steady_clock::time_point m_oldestPendingAt{}; ///<! When the first update since the last flush was queued
+
+  inline static constexpr std::size_t kMaxPendingUpdates = 500; ///<! Flush once this many repositories are pending
+  inline static constexpr std::chrono::seconds kMaxFlushDelay = std::chrono::seconds(30); ///<! Flush once the oldest pending update is this old
+};
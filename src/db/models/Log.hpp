@@ -4,10 +4,15 @@
 #include <string>
 #include <cstring>
 #include <ctime>
+#include <filesystem>
+#include <sstream>
 #include <sqlite_orm/sqlite_orm.h>
 #include <tgbotxx/utils/DateTimeUtils.hpp>
 #include <tgbotxx/utils/FileUtils.hpp>
 #include <source_location>
+#include <optional>
+#include <vector>
+#include "utils/Zstd.hpp"
 
 namespace models {
 
@@ -15,7 +20,8 @@ namespace models {
     std::int64_t id{};
     std::string severity; // TRACE, INFO, WARN, ERROR..
     std::string shortMessage; // Summary
-    std::string longMessage; // Larger text, dump of json of update for example
+    std::string longMessage; // Larger text, dump of json of update for example. Empty when compressed into longMessageZstd
+    std::optional<std::vector<char>> longMessageZstd; // longMessage compressed with zstd when it's kCompressionThreshold bytes or more. Use setLongMessage()/getLongMessage()
     std::time_t timestamp{};
     // source location
     std::string filename;
@@ -30,6 +36,7 @@ namespace models {
                         make_column("severity", &Log::severity),
                         make_column("shortMessage", &Log::shortMessage),
                         make_column("longMessage", &Log::longMessage, default_value("")),
+                        make_column("longMessageZstd", &Log::longMessageZstd),
                         make_column("timestamp", &Log::timestamp),
                         make_column("filename", &Log::filename),
                         make_column("line", &Log::line),
@@ -38,12 +45,37 @@ namespace models {
       );
     }
 
+    inline static constexpr std::size_t kCompressionThreshold = 256; ///<! Long messages this size or larger are stored compressed
+    inline static constexpr int kCompressionLevel = 6; ///<! Logs are compressed on the LogWriter thread, so a level above zstd's default is affordable
+
+    /// @brief Returns the codec long messages are compressed with, it uses res/Logs.zdict as dictionary if it exists
+    static const Zstd &codec() {
+      static const Zstd zstd(kCompressionLevel, std::filesystem::path(RES_DIR) / "Logs.zdict");
+      return zstd;
+    }
+
+    /// @brief Sets long message, compressing it if it's large
+    void setLongMessage(std::string msg) {
+      if (msg.size() >= kCompressionThreshold) {
+        longMessageZstd = codec().compress(msg);
+        longMessage.clear();
+      } else {
+        longMessageZstd.reset();
+        longMessage = std::move(msg);
+      }
+    }
+
+    /// @brief Returns long message, decompressing it if it was stored compressed
+    [[nodiscard]] std::string getLongMessage() const {
+      return longMessageZstd ? codec().decompress(*longMessageZstd) : longMessage;
+    }
+
     Log() = default;
 
     Log(const std::string &sev, const std::string &shortMsg, const std::string &longMsg = "", const std::source_location& here = std::source_location::current()) {
       severity = sev;
       shortMessage = shortMsg;
-      longMessage = longMsg;
+      setLongMessage(longMsg);
       timestamp = std::time(nullptr);
       filename = here.file_name();
       line = here.line();
@@ -54,7 +86,7 @@ namespace models {
 
     std::string toString() const noexcept {
       std::ostringstream oss{};
-      oss << fs::path(filename).filename().string() << ':' << line << ':' << column << " [" << functionName << "] [" << tgbotxx::DateTimeUtils::toString(timestamp) << "] [" << severity << "]: " << shortMessage;
+      oss << std::filesystem::path(filename).filename().string() << ':' << line << ':' << column << " [" << functionName << "] [" << tgbotxx::DateTimeUtils::toString(timestamp) << "] [" << severity << "]: " << shortMessage;
       return oss.str();
     }
   };
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include "sqlite_orm/sqlite_orm.h"
+
+namespace models {
+
+  /// @brief Progress of moving the Logs table of Database.db into Logs.db, a single row kept in Logs.db (see Database::migrateLogs())
+  struct LogsMigration {
+    std::int64_t id{kId};
+    std::int64_t migrated_up_to{}; ///<! Database.db id of the last migrated log, saved in the same transaction as the logs up to it
+
+    inline static constexpr std::int64_t kId = 1; ///<! Id of the single row
+
+    static auto table() {
+      using namespace sqlite_orm;
+      return make_table("LogsMigration",
+                        make_column("id", &LogsMigration::id, primary_key()),
+                        make_column("migrated_up_to", &LogsMigration::migrated_up_to)
+      );
+    }
+  };
+}
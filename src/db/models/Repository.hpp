@@ -23,12 +23,17 @@ namespace models {
     std::string language;
     std::time_t createdAt{};
     std::time_t updatedAt{};
-    std::unique_ptr<UserId> watcher_id; ///<! User id who is watching changes on this repo
+    std::time_t pullsUpdatedAt{}; ///<! When pulls_count was last fetched, it's refreshed less often than the other counters
+    std::time_t next_poll_at{}; ///<! When the watchdog should poll this repository next
+    std::int64_t poll_interval{}; ///<! Current polling interval in seconds, shrinks while the repository is active and grows while it's dormant (0: default)
+    std::time_t last_changed_at{}; ///<! When the watchdog last saw a counter change
+    std::string etag; ///<! ETag of the last GitHub response, sent back as If-None-Match
+    std::string last_modified; ///<! Last-Modified of the last GitHub response, sent back as If-Modified-Since
 
     static auto table() {
       using namespace sqlite_orm;
       return make_table("Repositories",
-                        make_column("id", &Repository::id), // this is repository id from GitHub Api, don't make it primary_key() since multiple users can watch the same repository
+                        make_column("id", &Repository::id, primary_key()), // this is repository id from GitHub Api, users watching it are in the Watches table
                         make_column("full_name", &Repository::full_name),
                         make_column("stargazers_count", &Repository::stargazers_count),
                         make_column("watchers_count", &Repository::watchers_count),
@@ -40,11 +45,12 @@ namespace models {
                         make_column("language", &Repository::language),
                         make_column("createdAt", &Repository::createdAt),
                         make_column("updatedAt", &Repository::updatedAt),
-                        make_column("watcher_id", &Repository::watcher_id),
-                        foreign_key(&Repository::watcher_id).references(&User::id)
-                        //primary_key(&Repository::id, &Repository::watcher_id) // TODO: don't try this, doesn't work with sqlite orm,
-                        // try it later in separate project (Primary key ownership is repo id + watcher id since multiple
-                        // users can watch the same repository, this way we can call storage.update(repo))
+                        make_column("pullsUpdatedAt", &Repository::pullsUpdatedAt, default_value(0)),
+                        make_column("next_poll_at", &Repository::next_poll_at, default_value(0)),
+                        make_column("poll_interval", &Repository::poll_interval, default_value(0)),
+                        make_column("last_changed_at", &Repository::last_changed_at, default_value(0)),
+                        make_column("etag", &Repository::etag, default_value("")),
+                        make_column("last_modified", &Repository::last_modified, default_value(""))
       );
     }
 
@@ -70,18 +76,7 @@ namespace models {
       DESERIALIZE(description);
       DESERIALIZE(size);
       DESERIALIZE(language);
-
-
-
-      // for pulls its different https://stackoverflow.com/questions/40534533/count-open-pull-requests-and-issues-on-github
-      // https://api.github.com/search/issues?q=repo:baderouaich/tgbotxx%20is:pr%20is:open&per_page=1
-      try {
-        auto res = cpr::Get(cpr::Url("https://api.github.com/search/issues?q=repo:" + full_name + "%20is:pr%20is:open&per_page=1"));
-        nl::json data = nl::json::parse(res.text);
-        pulls_count = data["total_count"];
-      } catch (const std::exception &e) {
-        throw std::runtime_error("Failed to get pulls_count for " + full_name + ": " + e.what());
-      }
+      // pulls_count is not part of the repository json, it's fetched separately with GitApi::getPullsCount()
 
       createdAt = std::time(nullptr);
       updatedAt = createdAt;
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <ctime>
+#include "sqlite_orm/sqlite_orm.h"
+#include "User.hpp"
+#include "Repository.hpp"
+
+namespace models {
+
+  /// @brief A User watching a Repository. Repositories are stored once no matter how many users watch them.
+  struct Watch {
+    UserId user_id{};
+    RepositoryId repo_id{};
+    std::time_t createdAt{};
+
+    static auto table() {
+      using namespace sqlite_orm;
+      return make_table("Watches",
+                        make_column("user_id", &Watch::user_id),
+                        make_column("repo_id", &Watch::repo_id),
+                        make_column("createdAt", &Watch::createdAt, default_value(0)),
+                        primary_key(&Watch::user_id, &Watch::repo_id),
+                        foreign_key(&Watch::user_id).references(&User::id),
+                        foreign_key(&Watch::repo_id).references(&Repository::id)
+      );
+    }
+  };
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <ostream>
+#include <source_location>
+#include "db/models/Log.hpp"
+#include "log/LogStream.hpp"
+
+/// Numeric log levels, usable in preprocessor conditions (see LOG_MIN_LEVEL in Logger.hpp)
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_ERROR 3
+
+enum class LogLevel : std::uint8_t {
+  Trace = LOG_LEVEL_TRACE,
+  Info = LOG_LEVEL_INFO,
+  Warn = LOG_LEVEL_WARN,
+  Error = LOG_LEVEL_ERROR,
+};
+
+/// @brief Returns level name as saved in the Logs severity column
+constexpr const char *toString(LogLevel level) noexcept {
+  switch (level) {
+    case LogLevel::Trace: return "trace";
+    case LogLevel::Info: return "info";
+    case LogLevel::Warn: return "warn";
+    case LogLevel::Error: return "error";
+  }
+  return "unknown";
+}
+
+/// @brief Log entry as built by the LOG macros on the logging thread.
+/// Messages are formatted into inline buffers and the source location is kept as static strings,
+/// the models::Log row (and its std::strings) is only built on the LogWriter thread.
+struct LogRecord {
+  inline static constexpr std::size_t kShortMessageCapacity = 256; ///<! Inline capacity of shortMessage, longer text spills to the heap
+
+  LogLevel level;
+  std::time_t timestamp;
+  std::source_location where;
+  LogStream<kShortMessageCapacity> shortMessage{};
+  LogStream<0> longMessage{}; ///<! Usually empty or a json dump, which is a heap string anyway
+
+  explicit LogRecord(LogLevel lvl, const std::source_location &here = std::source_location::current()) noexcept
+      : level(lvl), timestamp(std::time(nullptr)), where(here) {}
+
+  /// @brief Writes record to os formatted like models::Log::toString(), without building a models::Log (no long message compression)
+  friend std::ostream &operator<<(std::ostream &os, const LogRecord &record) {
+    return os << std::filesystem::path(record.where.file_name()).filename().string() << ':' << record.where.line() << ':' << record.where.column()
+              << " [" << record.where.function_name() << "] [" << tgbotxx::DateTimeUtils::toString(record.timestamp) << "] ["
+              << toString(record.level) << "]: " << record.shortMessage.view();
+  }
+
+  /// @brief Converts record to a Logs table row [LogWriter thread]
+  [[nodiscard]] models::Log toLog() const {
+    models::Log log{};
+    log.severity = toString(level);
+    log.shortMessage = shortMessage.str();
+    log.setLongMessage(longMessage.str());
+    log.timestamp = timestamp;
+    log.filename = where.file_name();
+    log.line = where.line();
+    log.column = where.column();
+    log.functionName = where.function_name();
+    return log;
+  }
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include <array>
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+/// @brief Stream the LOG macros format messages into.
+/// Text is written into an inline buffer of N characters (on the stack when the stream is a local), and numbers are
+/// formatted with std::to_chars, so formatting a typical log message doesn't touch the heap nor an std::locale.
+/// Text that doesn't fit spills over to an std::string.
+template<std::size_t N>
+class LogStream {
+public:
+  LogStream &operator<<(std::string_view str) {
+    append(str);
+    return *this;
+  }
+  LogStream &operator<<(const char *str) {
+    if (str) append(std::string_view(str));
+    return *this;
+  }
+  LogStream &operator<<(const std::string &str) {
+    append(str);
+    return *this;
+  }
+  LogStream &operator<<(char c) {
+    append(std::string_view(&c, 1));
+    return *this;
+  }
+  LogStream &operator<<(bool b) {
+    append(b ? "true" : "false");
+    return *this;
+  }
+  template<typename T>
+    requires(std::integral<T> || std::floating_point<T>) && (!std::same_as<T, char>) && (!std::same_as<T, bool>)
+  LogStream &operator<<(T value) {
+    std::array<char, 64> digits{};
+    const auto [end, ec] = std::to_chars(digits.data(), digits.data() + digits.size(), value);
+    if (ec == std::errc{}) append(std::string_view(digits.data(), end));
+    return *this;
+  }
+  /// @brief Anything else that can be written to an std::ostream (e.g enums with operator<<) goes through an std::ostringstream
+  template<typename T>
+    requires(!std::is_arithmetic_v<T>) && (!std::is_convertible_v<const T &, std::string_view>) && requires(std::ostream &os, const T &t) { os << t; }
+  LogStream &operator<<(const T &value) {
+    std::ostringstream oss{};
+    oss << value;
+    append(oss.str());
+    return *this;
+  }
+
+  /// @brief Returns formatted text
+  [[nodiscard]] std::string_view view() const noexcept {
+    return m_overflow.empty() ? std::string_view(m_buffer.data(), m_size) : std::string_view(m_overflow);
+  }
+  [[nodiscard]] std::string str() const { return std::string(view()); }
+  [[nodiscard]] bool empty() const noexcept { return m_size == 0 && m_overflow.empty(); }
+
+private:
+  void append(std::string_view str) {
+    if (m_overflow.empty() && m_size + str.size() <= N) {
+      str.copy(m_buffer.data() + m_size, str.size());
+      m_size += str.size();
+      return;
+    }
+    if (m_overflow.empty()) m_overflow.assign(m_buffer.data(), m_size); // spill over to the heap once
+    m_overflow.append(str);
+  }
+
+private:
+  std::array<char, N> m_buffer;
+  std::size_t m_size{};
+  std::string m_overflow; ///<! Used instead of m_buffer once the text doesn't fit in it
+};
@@ -0,0 +1,92 @@
+#include "LogWriter.hpp"
+#include <ctime>
+#include <iostream>
+#include <vector>
+#include "db/Database.hpp"
+
+LogWriter &LogWriter::instance() {
+  static LogWriter writer{};
+  return writer;
+}
+
+LogWriter::LogWriter() {
+  // Make sure the logs storage is constructed before the writer, so it's destroyed after the writer's final flush at exit.
+  (void) Database::getLogStorage();
+  m_thread = std::thread(&LogWriter::run, this);
+}
+
+LogWriter::~LogWriter() {
+  stop();
+}
+
+void LogWriter::push(LogRecord &&record) {
+  // Registered before checking m_running (both seq_cst), so either we see the writer stopping, or stop() waits for this push before its final flush
+  m_pushing.fetch_add(1);
+  if (not m_running.load()) [[unlikely]] {
+    m_pushing.fetch_sub(1);
+    // Writer thread has stopped (exiting), save it right away so nothing gets lost
+    Database::addLogs({record.toLog()});
+    return;
+  }
+  m_queue.push(std::move(record));
+  m_pushing.fetch_sub(1);
+}
+
+void LogWriter::stop() {
+  {
+    std::lock_guard guard{m_mutex};
+    if (not m_running.exchange(false)) return;
+  }
+  m_cv.notify_one();
+  if (m_thread.joinable()) m_thread.join();
+  while (m_pushing.load() != 0) { // pushes that saw m_running still true are queuing their record
+    std::this_thread::yield();
+  }
+  flush(); // writer thread is gone, save whatever was pushed while it was stopping
+}
+
+void LogWriter::run() {
+  std::chrono::steady_clock::time_point lastPrune{}; // prune once at startup
+  while (m_running) {
+    {
+      std::unique_lock lock{m_mutex};
+      m_cv.wait_for(lock, kFlushInterval, [this] { return not m_running.load(); });
+    }
+    flush();
+    if (std::chrono::steady_clock::now() - lastPrune >= kPruneInterval) {
+      prune();
+      lastPrune = std::chrono::steady_clock::now();
+    }
+  }
+}
+
+void LogWriter::flush() {
+  std::vector<models::Log> batch{};
+  batch.reserve(kMaxBatchSize);
+  while (not m_queue.empty()) {
+    while (batch.size() < kMaxBatchSize) {
+      std::optional<LogRecord> record = m_queue.pop();
+      if (not record) break;
+      batch.push_back(record->toLog());
+    }
+    try {
+      Database::addLogs(batch);
+    } catch (const std::exception &e) {
+      std::cerr << "Failed to save " << batch.size() << " logs: " << e.what() << std::endl;
+    }
+    batch.clear();
+  }
+}
+
+void LogWriter::prune() {
+  try {
+    const std::time_t olderThan = std::time(nullptr) - std::chrono::duration_cast<std::chrono::seconds>(kLogsRetention).count();
+    if (std::size_t removed = Database::pruneLogs(olderThan, kLogsMaxSize)) {
+      LogRecord record(LogLevel::Info);
+      record.shortMessage << "Pruned " << removed << " old logs";
+      m_queue.push(std::move(record));
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Failed to prune logs: " << e.what() << std::endl;
+  }
+}
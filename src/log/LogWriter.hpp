@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "log/LogRecord.hpp"
+#include "utils/MpscQueue.hpp"
+
+/// @brief Asynchronous log sink used by the LOG macros.
+/// Log records are pushed onto a lock-free queue by any thread, and a background writer thread
+/// converts them to models::Log rows and saves them to the logs database in batched transactions, so logging never contends with user facing queries.
+/// The writer thread also prunes old logs periodically so the logs database doesn't grow forever.
+class LogWriter {
+public:
+  /// @brief Returns the process wide log writer, starting its writer thread on first use
+  static LogWriter &instance();
+
+  /// @brief Queues a log record to be saved by the writer thread [lock-free, any thread]
+  void push(LogRecord &&record);
+
+  /// @brief Saves everything queued so far and stops the writer thread. Logs pushed afterwards are saved synchronously.
+  void stop();
+
+  ~LogWriter();
+  LogWriter(const LogWriter &) = delete;
+  LogWriter &operator=(const LogWriter &) = delete;
+
+private:
+  LogWriter();
+
+  /// @brief Writer thread loop, flushes the queue every kFlushInterval
+  void run();
+  /// @brief Saves queued logs in batches of up to kMaxBatchSize per transaction [writer thread]
+  void flush();
+  /// @brief Applies logs retention (kLogsRetention, kLogsMaxSize) [writer thread]
+  void prune();
+
+private:
+  MpscQueue<LogRecord> m_queue;
+  std::thread m_thread;
+  std::mutex m_mutex; ///<! Only used by the writer thread to sleep and by stop() to wake it up
+  std::condition_variable m_cv;
+  std::atomic<bool> m_running{true};
+  std::atomic<std::size_t> m_pushing{0}; ///<! push() calls queuing a record, stop() waits for them before its final flush
+
+  inline static constexpr std::chrono::milliseconds kFlushInterval{250}; ///<! How often queued logs are saved
+  inline static constexpr std::size_t kMaxBatchSize = 1024; ///<! Max logs saved per transaction
+  inline static constexpr std::chrono::days kLogsRetention{30}; ///<! Logs older than this are removed
+  inline static constexpr std::uintmax_t kLogsMaxSize = 256ull * 1024 * 1024; ///<! Logs database file size (bytes) above which the oldest logs are removed
+  inline static constexpr std::chrono::hours kPruneInterval{1}; ///<! How often logs retention is applied
+};
@@ -3,8 +3,8 @@
 #include <ctime>
 #include <fstream>
 #include <iostream>
-#include <sstream>
-#include "db/models/Log.hpp"
+#include "log/LogRecord.hpp"
+#include "log/LogWriter.hpp"
 
 #define KNRM "\x1B[0m"
 #define KRED "\x1B[31m"
@@ -21,32 +21,61 @@ static constexpr bool kLogToConsole = false;
 static constexpr bool kLogToConsole = true;
 #endif
 
-/// @brief Logs to console on Debug mode and saves log to db.
-#define LOG(level, txt, longTxt, color)                         \
-  try                                                           \
-  {                                                             \
-    std::ostringstream logoss{}, logosslng{};                   \
-    logoss << txt;                                              \
-    logosslng << longTxt;                                       \
-    models::Log newLog(level, logoss.str(), logosslng.str());   \
-    Database::addLog(newLog);                                   \
-    if constexpr (kLogToConsole)                                \
-    {                                                           \
-      std::cout << color << newLog.toString() << std::endl;     \
-    }                                                           \
-  }                                                             \
-  catch (const std::exception &e)                               \
-  {                                                             \
-    std::cerr << "Failed to log [" << txt << "]: " << e.what(); \
+/// Minimum level of logs compiled in, LOG macros below it expand to nothing (arguments aren't even evaluated).
+/// Defaults to trace on Debug and info on Release, override with -DLOG_MIN_LEVEL=<0..3> (see CMakeLists.txt)
+#ifndef LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define LOG_MIN_LEVEL LOG_LEVEL_INFO
+#else
+#define LOG_MIN_LEVEL LOG_LEVEL_TRACE
+#endif
+#endif
+
+/// @brief Logs to console on Debug mode and queues log to be saved to db by the LogWriter thread.
+/// Messages are formatted into the record's inline buffers, so logging doesn't allocate unless the text is long.
+#define LOG(level, txt, longTxt, color)                          \
+  try                                                            \
+  {                                                              \
+    LogRecord logRecord(level);                                  \
+    logRecord.shortMessage << txt;                               \
+    logRecord.longMessage << longTxt;                            \
+    if constexpr (kLogToConsole)                                 \
+    {                                                            \
+      std::cout << color << logRecord << std::endl;              \
+    }                                                            \
+    LogWriter::instance().push(std::move(logRecord));            \
+  }                                                              \
+  catch (const std::exception &e)                                \
+  {                                                              \
+    std::cerr << "Failed to log [" << txt << "]: " << e.what();  \
   }
 
+/// Expands to an empty statement for levels below LOG_MIN_LEVEL
+#define LOG_DISABLED {}
 
-#define LOGT(txt) LOG("trace", txt, "", KNRM)
-#define LOGI(txt) LOG("info", txt, "", KGRN)
-#define LOGW(txt) LOG("warn", txt, "", KYEL)
-#define LOGE(txt) LOG("error", txt, "", KRED)
+#if LOG_MIN_LEVEL <= LOG_LEVEL_TRACE
+#define LOGT(txt) LOG(LogLevel::Trace, txt, "", KNRM)
+#define LOGT2(txt, longTxt) LOG(LogLevel::Trace, txt, longTxt, KNRM)
+#else
+#define LOGT(txt) LOG_DISABLED
+#define LOGT2(txt, longTxt) LOG_DISABLED
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_INFO
+#define LOGI(txt) LOG(LogLevel::Info, txt, "", KGRN)
+#define LOGI2(txt, longTxt) LOG(LogLevel::Info, txt, longTxt, KGRN)
+#else
+#define LOGI(txt) LOG_DISABLED
+#define LOGI2(txt, longTxt) LOG_DISABLED
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_WARN
+#define LOGW(txt) LOG(LogLevel::Warn, txt, "", KYEL)
+#define LOGW2(txt, longTxt) LOG(LogLevel::Warn, txt, longTxt, KYEL)
+#else
+#define LOGW(txt) LOG_DISABLED
+#define LOGW2(txt, longTxt) LOG_DISABLED
+#endif
 
-#define LOGT2(txt, longTxt) LOG("trace", txt, longTxt, KNRM)
-#define LOGI2(txt, longTxt) LOG("info", txt, longTxt, KGRN)
-#define LOGW2(txt, longTxt) LOG("warn", txt, longTxt, KYEL)
-#define LOGE2(txt, longTxt) LOG("error", txt, longTxt, KRED)
+#define LOGE(txt) LOG(LogLevel::Error, txt, "", KRED)
+#define LOGE2(txt, longTxt) LOG(LogLevel::Error, txt, longTxt, KRED)
@@ -0,0 +1,28 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+
+/// @brief Jittered exponential backoff: retry number n waits a random delay in [d/2, d] where d = base * 2^(n-1), capped at max.
+/// The jitter spreads the retries of requests that failed together (e.g during an outage) instead of sending them all again at once.
+class Backoff {
+public:
+  using Duration = std::chrono::milliseconds;
+
+  constexpr Backoff(Duration base, Duration max) noexcept : m_base(base), m_max(max) {}
+
+  /// @brief Returns how long to wait before retry number attempt (1 for the first retry)
+  [[nodiscard]] Duration delay(std::size_t attempt) const {
+    const std::size_t exponent = std::min<std::size_t>(attempt > 0 ? attempt - 1 : 0, 30);
+    const Duration ceiling = std::min(m_max, m_base * (std::int64_t{1} << exponent));
+    thread_local std::minstd_rand rng{std::random_device{}()};
+    std::uniform_int_distribution<Duration::rep> jitter(ceiling.count() / 2, ceiling.count());
+    return Duration(jitter(rng));
+  }
+
+private:
+  Duration m_base;
+  Duration m_max;
+};
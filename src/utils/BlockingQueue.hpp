@@ -0,0 +1,69 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+/// @brief Thread safe FIFO queue to pass items between pipeline stages.
+/// Producers block on push() when the queue is full, consumers block on pop() until an item is available
+/// or the queue is closed and drained.
+template<typename T>
+class BlockingQueue {
+public:
+  explicit BlockingQueue(std::size_t capacity = std::numeric_limits<std::size_t>::max()) noexcept
+    : m_capacity(capacity) {}
+
+  BlockingQueue(const BlockingQueue &) = delete;
+  BlockingQueue &operator=(const BlockingQueue &) = delete;
+
+  /// @brief Pushes item to the back of the queue, waits while the queue is full.
+  /// @returns false if the queue was closed and item was not pushed
+  bool push(T item) {
+    std::unique_lock lock{m_mutex};
+    m_notFull.wait(lock, [this] { return m_closed || m_items.size() < m_capacity; });
+    if (m_closed) return false;
+    m_items.push_back(std::move(item));
+    lock.unlock();
+    m_notEmpty.notify_one();
+    return true;
+  }
+
+  /// @brief Pops an item from the front of the queue, waits while the queue is empty.
+  /// @returns std::nullopt once the queue is closed and all items were consumed
+  std::optional<T> pop() {
+    std::unique_lock lock{m_mutex};
+    m_notEmpty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+    if (m_items.empty()) return std::nullopt;
+    T item = std::move(m_items.front());
+    m_items.pop_front();
+    lock.unlock();
+    m_notFull.notify_one();
+    return item;
+  }
+
+  /// @brief Closes the queue, no more items can be pushed and consumers are woken up to drain what's left
+  void close() {
+    {
+      std::lock_guard guard{m_mutex};
+      m_closed = true;
+    }
+    m_notEmpty.notify_all();
+    m_notFull.notify_all();
+  }
+
+  [[nodiscard]] std::size_t size() const {
+    std::lock_guard guard{m_mutex};
+    return m_items.size();
+  }
+
+private:
+  mutable std::mutex m_mutex;
+  std::condition_variable m_notEmpty;
+  std::condition_variable m_notFull;
+  std::deque<T> m_items;
+  std::size_t m_capacity;
+  bool m_closed{false};
+};
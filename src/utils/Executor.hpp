@@ -0,0 +1,318 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+/// @brief Lane a task is queued to, workers always run queued interactive tasks first
+enum class TaskPriority : std::uint8_t {
+  Interactive, ///<! User facing handlers (commands, buttons), their latency is what users feel
+  Background, ///<! Everything else
+};
+
+/// @brief What submit() does when a lane is full
+enum class OverflowPolicy : std::uint8_t {
+  Block, ///<! Wait until the lane has room (on a worker thread the task runs in the caller instead, a worker waiting on workers could deadlock)
+  Reject, ///<! Don't run the task, submit() returns false
+  CallerRuns, ///<! Run the task right away on the submitting thread, which slows the producer down
+};
+
+/// @brief Work-stealing thread pool with bounded lanes.
+/// Each worker has its own queue of background tasks, and steals from the other workers queues when its own is empty,
+/// so a burst of tasks spreads over all workers without them contending on a single queue.
+/// Interactive tasks go to a separate lane that every worker checks before any background task, so they don't wait behind a burst of background tasks.
+/// Each lane holds up to its capacity of queued tasks, then applies its OverflowPolicy, so memory doesn't grow without bound under load.
+class Executor {
+public:
+  struct Options {
+    std::size_t threads = std::max(2u, std::thread::hardware_concurrency());
+    std::size_t interactiveCapacity = 256;
+    OverflowPolicy interactiveOverflow = OverflowPolicy::Reject;
+    std::size_t backgroundCapacity = 1024;
+    OverflowPolicy backgroundOverflow = OverflowPolicy::Block;
+    std::function<void(std::exception_ptr)> onError{}; ///<! Called with exceptions escaping tasks (on the thread that ran the task)
+  };
+
+  struct LaneStats {
+    std::size_t capacity{};
+    std::size_t depth{}; ///<! Tasks queued right now
+    std::size_t peakDepth{};
+    std::uint64_t submitted{};
+    std::uint64_t executed{};
+    std::uint64_t rejected{};
+    std::uint64_t callerRuns{};
+  };
+
+  struct WorkerStats {
+    std::size_t depth{}; ///<! Background tasks queued in the worker's own queue
+    std::uint64_t executed{};
+    std::uint64_t stolen{}; ///<! Tasks it took from other workers queues
+  };
+
+  struct Stats {
+    LaneStats interactive{};
+    LaneStats background{};
+    std::vector<WorkerStats> workers{};
+
+    friend std::ostream &operator<<(std::ostream &os, const Stats &stats) {
+      const auto lane = [&os](const char *name, const LaneStats &s) {
+        os << name << ' ' << s.depth << '/' << s.capacity << " queued (peak " << s.peakDepth << "), " << s.executed << '/' << s.submitted << " executed, "
+           << s.rejected << " rejected, " << s.callerRuns << " ran in caller";
+      };
+      lane("interactive", stats.interactive);
+      lane("; background", stats.background);
+      os << "; workers [depth/executed/stolen]";
+      for (const WorkerStats &w: stats.workers)
+        os << ' ' << w.depth << '/' << w.executed << '/' << w.stolen;
+      return os;
+    }
+  };
+
+  Executor() : Executor(Options{}) {}
+  explicit Executor(Options options) : m_options(std::move(options)) {
+    m_options.threads = std::max<std::size_t>(1, m_options.threads);
+    m_lanes[kInteractive].capacity = m_options.interactiveCapacity;
+    m_lanes[kInteractive].overflow = m_options.interactiveOverflow;
+    m_lanes[kBackground].capacity = m_options.backgroundCapacity;
+    m_lanes[kBackground].overflow = m_options.backgroundOverflow;
+    for (std::size_t i = 0; i < m_options.threads; ++i)
+      m_workers.push_back(std::make_unique<Worker>());
+    for (std::size_t i = 0; i < m_options.threads; ++i)
+      m_workers[i]->thread = std::jthread([this, i] { run(i); });
+  }
+
+  ~Executor() { stop(); }
+
+  Executor(const Executor &) = delete;
+  Executor &operator=(const Executor &) = delete;
+
+  /// @brief Queues task to the lane of priority, or applies the lane's OverflowPolicy if it's full
+  /// @returns false if the task was rejected (lane full with OverflowPolicy::Reject, or executor stopped)
+  bool submit(std::function<void()> task, TaskPriority priority = TaskPriority::Background) {
+    const std::size_t laneIndex = priority == TaskPriority::Interactive ? kInteractive : kBackground;
+    Lane &lane = m_lanes[laneIndex];
+    ++lane.submitted;
+    if (not reserve(lane)) {
+      if (m_stopped) {
+        ++lane.rejected;
+        return false;
+      }
+      switch (lane.overflow == OverflowPolicy::Block and t_executor == this ? OverflowPolicy::CallerRuns : lane.overflow) {
+        case OverflowPolicy::Reject:
+          ++lane.rejected;
+          return false;
+        case OverflowPolicy::CallerRuns:
+          ++lane.callerRuns;
+          execute(task, lane);
+          return true;
+        case OverflowPolicy::Block: {
+          std::unique_lock lock{m_mutex};
+          m_roomAvailable.wait(lock, [&] { return m_stopped or reserve(lane); });
+          if (m_stopped) {
+            ++lane.rejected;
+            return false;
+          }
+          break;
+        }
+      }
+    }
+
+    // Registered before checking m_stopped (both seq_cst), so either we see the executor stopping, or stop() waits for this push before its drain
+    m_submitting.fetch_add(1);
+    if (m_stopped.load()) [[unlikely]] {
+      m_submitting.fetch_sub(1);
+      --lane.depth; // give back the slot reserved before stop()
+      ++lane.rejected;
+      return false;
+    }
+    if (laneIndex == kInteractive) {
+      std::lock_guard guard{m_interactiveMutex};
+      m_interactive.push_back(std::move(task));
+    } else {
+      // Tasks submitted by a worker stay on its own queue, others are spread over the workers
+      Worker &worker = *m_workers[t_executor == this ? t_workerIndex : m_nextWorker++ % m_workers.size()];
+      std::lock_guard guard{worker.mutex};
+      worker.tasks.push_back(std::move(task));
+    }
+    {
+      std::lock_guard guard{m_mutex}; // a worker checking for work before going to sleep doesn't miss it
+      ++m_queued;
+    }
+    m_submitting.fetch_sub(1);
+    m_workAvailable.notify_one();
+    return true;
+  }
+
+  /// @brief Runs the tasks already queued, then joins the workers. Tasks submitted afterwards are rejected.
+  void stop() {
+    {
+      std::lock_guard guard{m_mutex};
+      if (m_stopped) return;
+      m_stopped = true;
+    }
+    m_workAvailable.notify_all();
+    m_roomAvailable.notify_all();
+    for (std::unique_ptr<Worker> &worker: m_workers)
+      if (worker->thread.joinable()) worker->thread.join();
+    while (m_submitting.load() != 0) { // submits that saw m_stopped still false are queuing their task
+      std::this_thread::yield();
+    }
+    // The workers may have left before those tasks were queued, run them here so no accepted task is lost
+    std::function<void()> task{};
+    Lane *lane{};
+    while (take(0, task, lane)) {
+      release(*lane);
+      execute(task, *lane);
+    }
+  }
+
+  [[nodiscard]] Stats stats() const {
+    Stats stats{};
+    const auto laneStats = [](const Lane &lane) {
+      return LaneStats{
+        .capacity = lane.capacity,
+        .depth = lane.depth.load(),
+        .peakDepth = lane.peakDepth.load(),
+        .submitted = lane.submitted.load(),
+        .executed = lane.executed.load(),
+        .rejected = lane.rejected.load(),
+        .callerRuns = lane.callerRuns.load(),
+      };
+    };
+    stats.interactive = laneStats(m_lanes[kInteractive]);
+    stats.background = laneStats(m_lanes[kBackground]);
+    for (const std::unique_ptr<Worker> &worker: m_workers) {
+      std::lock_guard guard{worker->mutex};
+      stats.workers.push_back(WorkerStats{.depth = worker->tasks.size(), .executed = worker->executed.load(), .stolen = worker->stolen.load()});
+    }
+    return stats;
+  }
+
+private:
+  struct Lane {
+    std::size_t capacity{};
+    OverflowPolicy overflow{};
+    std::atomic<std::size_t> depth{};
+    std::atomic<std::size_t> peakDepth{};
+    std::atomic<std::uint64_t> submitted{};
+    std::atomic<std::uint64_t> executed{};
+    std::atomic<std::uint64_t> rejected{};
+    std::atomic<std::uint64_t> callerRuns{};
+  };
+
+  struct Worker {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+    std::atomic<std::uint64_t> executed{};
+    std::atomic<std::uint64_t> stolen{};
+    std::jthread thread{};
+  };
+
+  /// @brief Takes a slot of lane if it isn't full
+  bool reserve(Lane &lane) {
+    if (m_stopped) return false;
+    std::size_t depth = lane.depth.load();
+    do {
+      if (depth >= lane.capacity) return false;
+    } while (not lane.depth.compare_exchange_weak(depth, depth + 1));
+    std::size_t peak = lane.peakDepth.load();
+    while (depth + 1 > peak and not lane.peakDepth.compare_exchange_weak(peak, depth + 1)) {}
+    return true;
+  }
+
+  /// @brief Gives back the slot of a task taken out of lane
+  void release(Lane &lane) {
+    --lane.depth;
+    {
+      std::lock_guard guard{m_mutex};
+      --m_queued;
+    }
+    m_roomAvailable.notify_all(); // submitters of both lanes wait on it
+  }
+
+  void execute(std::function<void()> &task, Lane &lane) {
+    try {
+      task();
+    } catch (...) {
+      if (m_options.onError) m_options.onError(std::current_exception());
+    }
+    ++lane.executed;
+  }
+
+  /// @brief Takes the next task for worker index: interactive lane first, then its own queue, then steals from the other workers
+  bool take(std::size_t index, std::function<void()> &task, Lane *&lane) {
+    {
+      std::lock_guard guard{m_interactiveMutex};
+      if (not m_interactive.empty()) {
+        task = std::move(m_interactive.front());
+        m_interactive.pop_front();
+        lane = &m_lanes[kInteractive];
+        return true;
+      }
+    }
+    for (std::size_t i = 0; i < m_workers.size(); ++i) {
+      Worker &victim = *m_workers[(index + i) % m_workers.size()];
+      std::lock_guard guard{victim.mutex};
+      if (victim.tasks.empty()) continue;
+      if (i == 0) { // own queue, oldest first
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+      } else { // steal the newest, the owner keeps its oldest tasks
+        task = std::move(victim.tasks.back());
+        victim.tasks.pop_back();
+        ++m_workers[index]->stolen;
+      }
+      lane = &m_lanes[kBackground];
+      return true;
+    }
+    return false;
+  }
+
+  void run(std::size_t index) {
+    t_executor = this;
+    t_workerIndex = index;
+    std::function<void()> task{};
+    Lane *lane{};
+    while (true) {
+      if (take(index, task, lane)) {
+        release(*lane);
+        execute(task, *lane);
+        ++m_workers[index]->executed;
+        task = nullptr; // release captures now, not when the next task comes
+        continue;
+      }
+      std::unique_lock lock{m_mutex};
+      m_workAvailable.wait(lock, [this] { return m_stopped or m_queued > 0; });
+      if (m_stopped and m_queued == 0) return;
+    }
+  }
+
+private:
+  inline static constexpr std::size_t kInteractive = 0;
+  inline static constexpr std::size_t kBackground = 1;
+
+  Options m_options;
+  Lane m_lanes[2]{};
+  std::mutex m_interactiveMutex;
+  std::deque<std::function<void()>> m_interactive; ///<! Interactive lane, shared by all workers
+  std::vector<std::unique_ptr<Worker>> m_workers;
+  std::atomic<std::size_t> m_nextWorker{0}; ///<! Round robin of tasks submitted from outside the workers
+  std::mutex m_mutex; ///<! Guards m_queued and m_stopped changes for workers and blocked submitters to wait on
+  std::condition_variable m_workAvailable;
+  std::condition_variable m_roomAvailable;
+  std::ptrdiff_t m_queued{}; ///<! Tasks queued in all lanes, briefly negative when a worker takes a task before its submitter counted it
+  std::atomic<bool> m_stopped{false};
+  std::atomic<std::size_t> m_submitting{0}; ///<! submit() calls queuing an accepted task, stop() waits for them before its drain
+
+  inline static thread_local const Executor *t_executor{nullptr}; ///<! Executor the current thread is a worker of
+  inline static thread_local std::size_t t_workerIndex{0};
+};
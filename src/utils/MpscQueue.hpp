@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <optional>
+#include <utility>
+
+/// @brief Unbounded lock-free multi producer single consumer queue (Dmitry Vyukov's intrusive MPSC node queue).
+/// push() is wait-free and can be called from any thread, pop() must only be called from a single consumer thread.
+/// @ref https://www.1024cores.net/home/lock-free-algorithms/queues/intrusive-mpsc-node-based-queue
+template<typename T>
+class MpscQueue {
+  struct Node {
+    std::atomic<Node *> next{nullptr};
+    std::optional<T> value{};
+  };
+
+public:
+  MpscQueue() : m_head(new Node()), m_tail(m_head.load(std::memory_order_relaxed)) {}
+  ~MpscQueue() {
+    while (pop()) {}
+    delete m_tail;
+  }
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+
+  /// @brief Pushes value to the back of the queue [any thread]
+  void push(T value) {
+    Node *node = new Node();
+    node->value.emplace(std::move(value));
+    Node *prev = m_head.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  /// @brief Pops value from the front of the queue [consumer thread only]
+  /// @returns std::nullopt if the queue is empty, or a producer is in the middle of pushing the next value
+  std::optional<T> pop() {
+    Node *tail = m_tail;
+    Node *next = tail->next.load(std::memory_order_acquire);
+    if (not next) return std::nullopt;
+    std::optional<T> value = std::move(next->value);
+    next->value.reset();
+    m_tail = next; // next becomes the new stub
+    delete tail;
+    return value;
+  }
+
+  /// @brief Returns true if there is nothing to pop [consumer thread only]
+  [[nodiscard]] bool empty() const {
+    return m_tail->next.load(std::memory_order_acquire) == nullptr;
+  }
+
+private:
+  std::atomic<Node *> m_head; ///<! Last pushed node, producers side
+  Node *m_tail; ///<! Stub node before the next value to pop, consumer side
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <openssl/evp.h>
+
+/// @brief SHA-256 digests (OpenSSL), fed at once with of() or piece by piece with update().
+/// Used where a collision would go unnoticed, e.g to tell changed database pages apart in backups.
+class Sha256 {
+public:
+  using Digest = std::array<std::uint8_t, 32>;
+
+  Sha256() : m_ctx(EVP_MD_CTX_new()) {
+    if (not m_ctx or EVP_DigestInit_ex(m_ctx.get(), EVP_sha256(), nullptr) != 1) {
+      throw std::runtime_error("Could not initialize SHA-256");
+    }
+  }
+
+  /// @brief Returns digest of data
+  [[nodiscard]] static Digest of(std::string_view data) {
+    Digest digest{};
+    if (EVP_Digest(data.data(), data.size(), digest.data(), nullptr, EVP_sha256(), nullptr) != 1) {
+      throw std::runtime_error("SHA-256 failed");
+    }
+    return digest;
+  }
+
+  /// @brief Appends data to the digested bytes
+  Sha256 &update(std::string_view data) {
+    if (EVP_DigestUpdate(m_ctx.get(), data.data(), data.size()) != 1) {
+      throw std::runtime_error("SHA-256 failed");
+    }
+    return *this;
+  }
+
+  /// @brief Returns digest of all the bytes passed to update(), the digest can't be updated afterwards
+  [[nodiscard]] Digest digest() {
+    Digest digest{};
+    if (EVP_DigestFinal_ex(m_ctx.get(), digest.data(), nullptr) != 1) {
+      throw std::runtime_error("SHA-256 failed");
+    }
+    return digest;
+  }
+
+private:
+  struct Deleter {
+    void operator()(EVP_MD_CTX *ctx) const noexcept { EVP_MD_CTX_free(ctx); }
+  };
+  std::unique_ptr<EVP_MD_CTX, Deleter> m_ctx;
+};
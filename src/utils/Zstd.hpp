@@ -0,0 +1,152 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <zstd.h>
+
+/// @brief zstd compressor/decompressor with an optional trained dictionary.
+/// A dictionary helps a lot with many small payloads that share the same shape (json of updates, GitHub responses...),
+/// it can be trained with the zstd cli: zstd --train samples/* -o dictionary.zdict
+/// Frames store the id of the dictionary they were compressed with, so data compressed without a dictionary
+/// (or before one was added) is still decompressed correctly. Instances are safe to use from multiple threads.
+/// Frames are standard zstd frames, they can be decompressed with the zstd cli too (zstd -d file.zst).
+class Zstd {
+public:
+  /// @param level zstd compression level [1, 19]
+  /// @param dictionaryFile optional dictionary to compress with, ignored if the file doesn't exist
+  explicit Zstd(int level = ZSTD_CLEVEL_DEFAULT, const std::filesystem::path &dictionaryFile = {}) : m_level(level) {
+    if (dictionaryFile.empty() or not std::filesystem::exists(dictionaryFile)) return;
+    std::ifstream ifs{dictionaryFile, std::ios::binary};
+    const std::vector<char> dictionary{std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+    m_cdict.reset(ZSTD_createCDict(dictionary.data(), dictionary.size(), m_level));
+    m_ddict.reset(ZSTD_createDDict(dictionary.data(), dictionary.size()));
+    if (not m_cdict or not m_ddict) {
+      throw std::runtime_error("Invalid zstd dictionary " + dictionaryFile.string());
+    }
+  }
+
+  /// @brief Returns id of the loaded dictionary, 0 if none
+  [[nodiscard]] unsigned dictionaryId() const noexcept {
+    return m_ddict ? ZSTD_getDictID_fromDDict(m_ddict.get()) : 0;
+  }
+
+  [[nodiscard]] std::vector<char> compress(std::string_view data) const {
+    std::vector<char> compressed(ZSTD_compressBound(data.size()));
+    ZSTD_CCtx *cctx = context<ZSTD_CCtx, ZSTD_createCCtx, ZSTD_freeCCtx>();
+    const std::size_t size = m_cdict ? ZSTD_compress_usingCDict(cctx, compressed.data(), compressed.size(), data.data(), data.size(), m_cdict.get())
+                                     : ZSTD_compressCCtx(cctx, compressed.data(), compressed.size(), data.data(), data.size(), m_level);
+    if (ZSTD_isError(size)) {
+      throw std::runtime_error(std::string("zstd compression failed: ") + ZSTD_getErrorName(size));
+    }
+    compressed.resize(size);
+    return compressed;
+  }
+
+  /// @brief Compresses large data into out as a single frame, written in ZSTD_CStreamOutSize() chunks
+  /// @param workers compression threads, 0 compresses on the calling thread (zstd must be built with multithreading support)
+  void compress(std::string_view data, std::ostream &out, int workers = 0) const {
+    Writer writer{*this, out, data.size(), workers};
+    writer.write(data);
+    writer.finish();
+  }
+
+  [[nodiscard]] std::string decompress(const std::vector<char> &compressed) const {
+    const unsigned long long contentSize = ZSTD_getFrameContentSize(compressed.data(), compressed.size());
+    if (contentSize == ZSTD_CONTENTSIZE_ERROR or contentSize == ZSTD_CONTENTSIZE_UNKNOWN) {
+      throw std::runtime_error("Not a zstd frame or unknown content size");
+    }
+    const unsigned frameDictId = ZSTD_getDictID_fromFrame(compressed.data(), compressed.size());
+    if (frameDictId != 0 and frameDictId != dictionaryId()) {
+      throw std::runtime_error("zstd frame was compressed with dictionary " + std::to_string(frameDictId) + " which is not loaded");
+    }
+
+    std::string data(static_cast<std::size_t>(contentSize), '\0');
+    ZSTD_DCtx *dctx = context<ZSTD_DCtx, ZSTD_createDCtx, ZSTD_freeDCtx>();
+    const std::size_t size = frameDictId ? ZSTD_decompress_usingDDict(dctx, data.data(), data.size(), compressed.data(), compressed.size(), m_ddict.get())
+                                         : ZSTD_decompressDCtx(dctx, data.data(), data.size(), compressed.data(), compressed.size());
+    if (ZSTD_isError(size)) {
+      throw std::runtime_error(std::string("zstd decompression failed: ") + ZSTD_getErrorName(size));
+    }
+    data.resize(size);
+    return data;
+  }
+
+private:
+  /// @brief Returns the calling thread's (de)compression context, contexts are reused because creating them allocates their tables
+  template<typename Ctx, Ctx *(*Create)(), std::size_t (*Free)(Ctx *)>
+  static Ctx *context() {
+    thread_local std::unique_ptr<Ctx, Deleter<Ctx, Free>> ctx{Create()};
+    return ctx.get();
+  }
+
+  template<typename T, std::size_t (*Free)(T *)>
+  struct Deleter {
+    void operator()(T *ptr) const noexcept { Free(ptr); }
+  };
+
+public:
+  /// @brief Compresses data that is too large to be held in memory into out as a single frame, fed piece by piece with write().
+  /// Memory use is bounded by the compression window (and the workers jobs), not by the data size.
+  class Writer {
+  public:
+    /// @param size total size of the data that will be written, saved in the frame header like compress() does
+    /// @param workers compression threads, 0 compresses on the calling thread (zstd must be built with multithreading support)
+    Writer(const Zstd &zstd, std::ostream &out, std::uint64_t size, int workers = 0) : m_out(out), m_cctx(ZSTD_createCCtx()), m_buffer(ZSTD_CStreamOutSize()) {
+      // Own context, its workers and window are too big to be kept per thread
+      check(ZSTD_CCtx_setParameter(m_cctx.get(), ZSTD_c_compressionLevel, zstd.m_level));
+      check(ZSTD_CCtx_setParameter(m_cctx.get(), ZSTD_c_nbWorkers, workers));
+      check(ZSTD_CCtx_setParameter(m_cctx.get(), ZSTD_c_checksumFlag, 1)); // large frames (e.g backups) are checked when decompressed
+      check(ZSTD_CCtx_setPledgedSrcSize(m_cctx.get(), size));
+      if (zstd.m_cdict) check(ZSTD_CCtx_refCDict(m_cctx.get(), zstd.m_cdict.get()));
+    }
+
+    /// @brief Compresses the next piece of data, writing compressed chunks to out as they are produced
+    void write(std::string_view data) {
+      ZSTD_inBuffer input{data.data(), data.size(), 0};
+      while (input.pos < input.size) {
+        flush(ZSTD_e_continue, input);
+      }
+    }
+
+    /// @brief Ends the frame, it's an error if less or more data than the pledged size was written
+    void finish() {
+      ZSTD_inBuffer input{nullptr, 0, 0};
+      while (flush(ZSTD_e_end, input) != 0) {}
+      if (not m_out) {
+        throw std::runtime_error("Failed to write zstd frame");
+      }
+    }
+
+  private:
+    std::size_t flush(ZSTD_EndDirective directive, ZSTD_inBuffer &input) {
+      ZSTD_outBuffer output{m_buffer.data(), m_buffer.size(), 0};
+      const std::size_t remaining = check(ZSTD_compressStream2(m_cctx.get(), &output, &input, directive));
+      m_out.write(m_buffer.data(), static_cast<std::streamsize>(output.pos));
+      return remaining;
+    }
+
+    static std::size_t check(std::size_t code) {
+      if (ZSTD_isError(code)) {
+        throw std::runtime_error(std::string("zstd compression failed: ") + ZSTD_getErrorName(code));
+      }
+      return code;
+    }
+
+  private:
+    std::ostream &m_out;
+    std::unique_ptr<ZSTD_CCtx, Deleter<ZSTD_CCtx, ZSTD_freeCCtx>> m_cctx;
+    std::vector<char> m_buffer;
+  };
+
+private:
+  int m_level;
+  std::unique_ptr<ZSTD_CDict, Deleter<ZSTD_CDict, ZSTD_freeCDict>> m_cdict{};
+  std::unique_ptr<ZSTD_DDict, Deleter<ZSTD_DDict, ZSTD_freeDDict>> m_ddict{};
+};